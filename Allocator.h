@@ -0,0 +1,228 @@
+/*
+ * Allocator.h
+ *
+ * Allocation policies for epl::vector. A policy is a class with two static
+ * member functions working in bytes:
+ *     static void* allocate(uint64_t bytes);
+ *     static void deallocate(void* p, uint64_t bytes);
+ * deallocate is always handed the same size that was allocated and may be
+ * called with a null pointer (and zero bytes) for moved-from vectors.
+ * A policy may also provide
+ *     static void* reallocate(void* p, uint64_t old_bytes, uint64_t new_bytes);
+ * with realloc semantics (p may be null); epl::vector then grows buffers of
+ * trivially copyable elements in place instead of copying them.
+ */
+
+#ifndef _Allocator_h
+#define _Allocator_h
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace epl {
+
+/* the C heap; realloc lets large buffers be remapped (mremap) instead of copied */
+struct default_allocator {
+	static void* allocate(uint64_t bytes) {
+		void* p = std::malloc(bytes == 0 ? 1 : bytes);
+		if (p == nullptr) { throw std::bad_alloc(); }
+		return p;
+	}
+
+	static void* reallocate(void* p, uint64_t, uint64_t bytes) {
+		void* q = std::realloc(p, bytes == 0 ? 1 : bytes);
+		if (q == nullptr) { throw std::bad_alloc(); }
+		return q;
+	}
+
+	static void deallocate(void* p, uint64_t) { std::free(p); }
+};
+
+/* true when Alloc provides reallocate */
+template <typename Alloc, typename = void>
+struct can_reallocate : public std::false_type {};
+
+template <typename Alloc>
+struct can_reallocate<Alloc, decltype((void) Alloc::reallocate(nullptr, 0, 0))> : public std::true_type {};
+
+/* aligned to Alignment bytes (a power of two), one cache line by default */
+template <uint64_t Alignment = 64>
+struct aligned_allocator {
+	static_assert((Alignment & (Alignment - 1)) == 0 && Alignment >= sizeof(void*), "alignment must be a power of two");
+
+	static constexpr uint64_t alignment = Alignment;
+
+	static void* allocate(uint64_t bytes) {
+		void* p = nullptr;
+#if defined(_MSC_VER)
+		p = _aligned_malloc(bytes == 0 ? 1 : bytes, Alignment);
+#else
+		if (posix_memalign(&p, Alignment, bytes == 0 ? 1 : bytes) != 0) { p = nullptr; }
+#endif
+		if (p == nullptr) { throw std::bad_alloc(); }
+		return p;
+	}
+
+	static void deallocate(void* p, uint64_t) {
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+};
+
+/*
+ * Buffers of at least one huge page are placed on huge page boundaries, padded
+ * to a whole number of huge pages and, on Linux, marked MADV_HUGEPAGE so that
+ * transparent huge pages can back them (one TLB entry per 2 MiB instead of
+ * per 4 KiB). Smaller buffers are simply cache line aligned.
+ */
+struct huge_page_allocator {
+	static constexpr uint64_t page = uint64_t(2) << 20;
+
+	static void* allocate(uint64_t bytes) {
+		if (bytes < page) { return aligned_allocator<64>::allocate(bytes); }
+		uint64_t rounded = (bytes + page - 1) / page * page;
+		void* p = aligned_allocator<page>::allocate(rounded);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		madvise(p, rounded, MADV_HUGEPAGE); // advisory; THP may be disabled system-wide
+#endif
+		return p;
+	}
+
+	static void deallocate(void* p, uint64_t bytes) {
+		if (bytes < page) {
+			aligned_allocator<64>::deallocate(p, bytes);
+		} else {
+			aligned_allocator<page>::deallocate(p, bytes);
+		}
+	}
+};
+
+/*
+ * buffer_pool caches freed pool_allocator buffers in size classes (powers of
+ * two and the midpoints between them, from 64 bytes up) using intrusive free
+ * lists, so a cached buffer costs no bookkeeping memory. Each thread has at
+ * most one active pool, installed by a pool_scope; it only ever holds buffers
+ * that were allocated with the global allocator at their class size, so a
+ * buffer may be freed into any pool (or none) regardless of where it came from.
+ */
+class buffer_pool {
+private:
+	static constexpr int classes = 2 * 64;
+
+	void* free_list[classes] = {};
+	uint64_t hit_count = 0;
+	uint64_t miss_count = 0;
+
+public:
+	buffer_pool(void) = default;
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+
+	~buffer_pool(void) {
+		for (int k = 0; k < classes; k += 1) {
+			while (free_list[k] != nullptr) {
+				void* next = *reinterpret_cast<void**>(free_list[k]);
+				aligned_allocator<64>::deallocate(free_list[k], class_bytes(k));
+				free_list[k] = next;
+			}
+		}
+	}
+
+	/* the calling thread's active pool, or nullptr outside any pool_scope */
+	static buffer_pool*& active(void) {
+		static thread_local buffer_pool* pool = nullptr;
+		return pool;
+	}
+
+	/* size class for a request of bytes */
+	static int class_of(uint64_t bytes) {
+		int k = 6; // 64 bytes
+		while ((uint64_t(1) << k) < bytes) { k += 1; }
+		uint64_t mid = (uint64_t(3) << k) >> 2; // three quarters of 2^k
+		return (k > 6 && bytes <= mid) ? 2 * k - 1 : 2 * k;
+	}
+
+	static uint64_t class_bytes(int c) {
+		return (c & 1) ? (uint64_t(3) << (c / 2 + 1)) >> 2 : uint64_t(1) << (c / 2);
+	}
+
+	/* a cached buffer of class c, or nullptr (counted as a miss) */
+	void* take(int c) {
+		void* p = free_list[c];
+		if (p == nullptr) {
+			miss_count += 1;
+			return nullptr;
+		}
+		free_list[c] = *reinterpret_cast<void**>(p);
+		hit_count += 1;
+		return p;
+	}
+
+	void give(void* p, int c) {
+		*reinterpret_cast<void**>(p) = free_list[c];
+		free_list[c] = p;
+	}
+
+	/* allocations served from the pool and those that reached the global allocator */
+	uint64_t hits(void) const { return hit_count; }
+	uint64_t misses(void) const { return miss_count; }
+};
+
+/*
+ * RAII binding of a fresh buffer_pool to the current thread. Scopes nest; the
+ * innermost is active. Buffers cached when the scope ends are released.
+ */
+class pool_scope {
+private:
+	buffer_pool local;
+	buffer_pool* previous;
+
+public:
+	pool_scope(void) : previous(buffer_pool::active()) { buffer_pool::active() = &local; }
+
+	pool_scope(const pool_scope&) = delete;
+	pool_scope& operator=(const pool_scope&) = delete;
+
+	~pool_scope(void) { buffer_pool::active() = previous; }
+
+	const buffer_pool& pool(void) const { return local; }
+};
+
+/*
+ * Recycles buffers through the thread's active buffer_pool, e.g. for
+ * valarray<double, epl::pool_allocator> temporaries created in every iteration
+ * of a loop: once each size has been seen, allocation never reaches the global
+ * allocator. Outside a pool_scope it behaves like aligned_allocator<64>.
+ */
+struct pool_allocator {
+	static void* allocate(uint64_t bytes) {
+		int c = buffer_pool::class_of(bytes);
+		if (buffer_pool* pool = buffer_pool::active()) {
+			if (void* p = pool->take(c)) { return p; }
+		}
+		return aligned_allocator<64>::allocate(buffer_pool::class_bytes(c));
+	}
+
+	static void deallocate(void* p, uint64_t bytes) {
+		if (p == nullptr) { return; }
+		int c = buffer_pool::class_of(bytes);
+		if (buffer_pool* pool = buffer_pool::active()) {
+			pool->give(p, c);
+		} else {
+			aligned_allocator<64>::deallocate(p, buffer_pool::class_bytes(c));
+		}
+	}
+};
+
+} //epl namespace
+
+#endif /* _Allocator_h */
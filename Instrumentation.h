@@ -0,0 +1,188 @@
+/*
+ * Instrumentation.h
+ *
+ * Thread-safe counters of what epl::vector and the expression evaluator do
+ * with memory, kept per element type and in total:
+ *     live_buffers / peak_buffers    buffers currently held (and the maximum)
+ *     allocations / deallocations    buffers obtained from / returned to a policy
+ *     bytes_allocated                bytes requested, including in-place growth
+ *     reallocations                  storage replaced to make room at either end
+ *     copies / moves                 deep copies and buffer transfers of vectors
+ *     materializations               expressions evaluated into a new buffer
+ * Take a snapshot before and after the code of interest; their difference is
+ * what that code did, e.g. (snapshot::all() - before).allocations == 0.
+ *
+ * The counters are relaxed atomics, so they may be read while other threads
+ * work but are not ordered with the rest of the program. Define
+ * EPL_NO_INSTRUMENTATION to compile every hook away; snapshots are then zero.
+ */
+
+#ifndef _Instrumentation_h
+#define _Instrumentation_h
+
+#include <atomic>
+#include <cstdint>
+
+namespace epl {
+
+#ifdef EPL_NO_INSTRUMENTATION
+constexpr bool instrumentation_enabled = false;
+#else
+constexpr bool instrumentation_enabled = true;
+#endif
+
+struct snapshot {
+	int64_t live_buffers = 0;
+	int64_t peak_buffers = 0;
+	uint64_t allocations = 0;
+	uint64_t deallocations = 0;
+	uint64_t bytes_allocated = 0;
+	uint64_t reallocations = 0;
+	uint64_t copies = 0;
+	uint64_t moves = 0;
+	uint64_t materializations = 0;
+
+	/* counters for vectors of T only, and for every element type together */
+	template <typename T>
+	static snapshot of(void);
+	static snapshot all(void);
+
+	/* the activity between two snapshots; peak_buffers is the later peak */
+	friend snapshot operator-(const snapshot& after, const snapshot& before) {
+		snapshot d;
+		d.live_buffers = after.live_buffers - before.live_buffers;
+		d.peak_buffers = after.peak_buffers;
+		d.allocations = after.allocations - before.allocations;
+		d.deallocations = after.deallocations - before.deallocations;
+		d.bytes_allocated = after.bytes_allocated - before.bytes_allocated;
+		d.reallocations = after.reallocations - before.reallocations;
+		d.copies = after.copies - before.copies;
+		d.moves = after.moves - before.moves;
+		d.materializations = after.materializations - before.materializations;
+		return d;
+	}
+};
+
+namespace instrumentation {
+
+struct counters {
+	std::atomic<int64_t> live_buffers{0};
+	std::atomic<int64_t> peak_buffers{0};
+	std::atomic<uint64_t> allocations{0};
+	std::atomic<uint64_t> deallocations{0};
+	std::atomic<uint64_t> bytes_allocated{0};
+	std::atomic<uint64_t> reallocations{0};
+	std::atomic<uint64_t> copies{0};
+	std::atomic<uint64_t> moves{0};
+	std::atomic<uint64_t> materializations{0};
+
+	void allocated(uint64_t bytes) {
+		int64_t live = live_buffers.fetch_add(1, std::memory_order_relaxed) + 1;
+		int64_t peak = peak_buffers.load(std::memory_order_relaxed);
+		while (live > peak && !peak_buffers.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	void deallocated(void) {
+		live_buffers.fetch_sub(1, std::memory_order_relaxed);
+		deallocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	snapshot load(void) const {
+		snapshot s;
+		s.live_buffers = live_buffers.load(std::memory_order_relaxed);
+		s.peak_buffers = peak_buffers.load(std::memory_order_relaxed);
+		s.allocations = allocations.load(std::memory_order_relaxed);
+		s.deallocations = deallocations.load(std::memory_order_relaxed);
+		s.bytes_allocated = bytes_allocated.load(std::memory_order_relaxed);
+		s.reallocations = reallocations.load(std::memory_order_relaxed);
+		s.copies = copies.load(std::memory_order_relaxed);
+		s.moves = moves.load(std::memory_order_relaxed);
+		s.materializations = materializations.load(std::memory_order_relaxed);
+		return s;
+	}
+};
+
+inline counters& total(void) {
+	static counters c;
+	return c;
+}
+
+template <typename T>
+counters& of(void) {
+	static counters c;
+	return c;
+}
+
+/* the hooks called by epl::vector and the evaluator */
+template <typename T>
+inline void allocated(uint64_t bytes) {
+	if (instrumentation_enabled) {
+		of<T>().allocated(bytes);
+		total().allocated(bytes);
+	}
+}
+
+template <typename T>
+inline void deallocated(void) {
+	if (instrumentation_enabled) {
+		of<T>().deallocated();
+		total().deallocated();
+	}
+}
+
+/* storage resized by the policy in place: still one buffer, grown by bytes */
+template <typename T>
+inline void reallocated(uint64_t bytes) {
+	if (instrumentation_enabled) {
+		of<T>().reallocations.fetch_add(1, std::memory_order_relaxed);
+		of<T>().bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+		total().reallocations.fetch_add(1, std::memory_order_relaxed);
+		total().bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+	}
+}
+
+/* storage replaced by a new buffer; the buffers themselves are counted separately */
+template <typename T>
+inline void relocated(void) {
+	if (instrumentation_enabled) {
+		of<T>().reallocations.fetch_add(1, std::memory_order_relaxed);
+		total().reallocations.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline void copied(void) {
+	if (instrumentation_enabled) {
+		of<T>().copies.fetch_add(1, std::memory_order_relaxed);
+		total().copies.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline void moved(void) {
+	if (instrumentation_enabled) {
+		of<T>().moves.fetch_add(1, std::memory_order_relaxed);
+		total().moves.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline void materialized(void) {
+	if (instrumentation_enabled) {
+		of<T>().materializations.fetch_add(1, std::memory_order_relaxed);
+		total().materializations.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+} //instrumentation namespace
+
+template <typename T>
+snapshot snapshot::of(void) { return instrumentation::of<T>().load(); }
+
+inline snapshot snapshot::all(void) { return instrumentation::total().load(); }
+
+} //epl namespace
+
+#endif /* _Instrumentation_h */
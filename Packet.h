@@ -0,0 +1,614 @@
+/*
+ * Packet.h
+ *
+ * SIMD packets used by the expression evaluator. A packet is a GCC/Clang
+ * vector extension type whose width follows the instruction set the
+ * translation unit is compiled for (-mavx512f, -mavx2, plain x86-64 SSE2, ...).
+ * Define EPL_NO_SIMD to force every expression down the scalar path.
+ * Define EPL_FAST_COMPLEX for the complex multiplication and division of
+ * -fcx-limited-range (see complex_packet).
+ */
+
+#ifndef _Packet_h
+#define _Packet_h
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE2__) && !defined(EPL_NO_SIMD)
+#include <immintrin.h>
+#endif
+
+#if defined(EPL_NO_SIMD) || !(defined(__GNUC__) || defined(__clang__))
+#define EPL_SIMD_BYTES 0
+#elif defined(__AVX512F__)
+#define EPL_SIMD_BYTES 64
+#elif defined(__AVX__)
+#define EPL_SIMD_BYTES 32
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+#define EPL_SIMD_BYTES 16
+#else
+#define EPL_SIMD_BYTES 0
+#endif
+
+namespace epl {
+
+/*
+ * packet_traits<T>::type is the packet holding packet_traits<T>::size lanes of T.
+ * Types without a packet report vectorizable == false and a single lane.
+ */
+template <typename T>
+struct packet_traits {
+	static constexpr bool vectorizable = false;
+	static constexpr uint64_t size = 1;
+	using type = T;
+};
+
+#if EPL_SIMD_BYTES > 0
+#define EPL_DEFINE_PACKET(T) \
+	template <> \
+	struct packet_traits<T> { \
+		static constexpr bool vectorizable = true; \
+		static constexpr uint64_t size = EPL_SIMD_BYTES / sizeof(T); \
+		typedef T type __attribute__((vector_size(EPL_SIMD_BYTES))); \
+	};
+
+EPL_DEFINE_PACKET(int)
+EPL_DEFINE_PACKET(float)
+EPL_DEFINE_PACKET(double)
+
+#undef EPL_DEFINE_PACKET
+#endif
+
+template <typename T>
+using packet = typename packet_traits<T>::type;
+
+/* loads and stores are unaligned; memcpy compiles to a single vector move.
+ * GCC's -Warray-bounds cannot see that the evaluator never reaches a full
+ * packet on arrays shorter than one, so it is silenced for these two. */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+template <typename T>
+inline packet<T> load_packet(const T* p) {
+	packet<T> result = {};
+	std::memcpy(&result, p, sizeof(result));
+	return result;
+}
+
+template <typename T>
+inline void store_packet(T* p, const packet<T>& value) {
+	std::memcpy(p, &value, sizeof(value));
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/* hints that *p will be read soon; a no-op where the compiler has no prefetch */
+inline void prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(p, 0, 3);
+#else
+	(void) p;
+#endif
+}
+
+template <typename T>
+inline packet<T> broadcast_packet(const T& value) {
+	packet<T> result = {};
+	for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+		result[k] = value;
+	}
+	return result;
+}
+
+/* true when any lane of a packet comparison (a == b, a < b, ...) holds */
+template <typename M>
+inline bool any_lane(const M& mask) {
+	auto acc = mask[0];
+	for (uint64_t k = 1; k < sizeof(M) / sizeof(mask[0]); ++k) {
+		acc |= mask[k];
+	}
+	return acc != 0;
+}
+
+#if EPL_SIMD_BYTES > 0
+/* correctly rounded square roots of every lane, in one instruction on x86 */
+#if EPL_SIMD_BYTES == 64 && defined(__AVX512F__)
+/* the masked forms, since GCC 12 warns about the unmasked ones' undefined source */
+inline packet<double> sqrt_lanes(const packet<double>& a) { return (packet<double>) _mm512_mask_sqrt_pd((__m512d) a, (__mmask8) -1, (__m512d) a); }
+inline packet<float> sqrt_lanes(const packet<float>& a) { return (packet<float>) _mm512_mask_sqrt_ps((__m512) a, (__mmask16) -1, (__m512) a); }
+#elif EPL_SIMD_BYTES == 32 && defined(__AVX__)
+inline packet<double> sqrt_lanes(const packet<double>& a) { return (packet<double>) _mm256_sqrt_pd((__m256d) a); }
+inline packet<float> sqrt_lanes(const packet<float>& a) { return (packet<float>) _mm256_sqrt_ps((__m256) a); }
+#elif EPL_SIMD_BYTES == 16 && defined(__SSE2__)
+inline packet<double> sqrt_lanes(const packet<double>& a) { return (packet<double>) _mm_sqrt_pd((__m128d) a); }
+inline packet<float> sqrt_lanes(const packet<float>& a) { return (packet<float>) _mm_sqrt_ps((__m128) a); }
+#else
+template <typename T>
+inline packet<T> sqrt_lanes_loop(const packet<T>& a) {
+	packet<T> result = {};
+	for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+		result[k] = std::sqrt(a[k]);
+	}
+	return result;
+}
+
+inline packet<double> sqrt_lanes(const packet<double>& a) { return sqrt_lanes_loop<double>(a); }
+inline packet<float> sqrt_lanes(const packet<float>& a) { return sqrt_lanes_loop<float>(a); }
+#endif
+#endif
+
+/*
+ * EPL_FMA is defined when the target multiplies and adds with a single rounding
+ * in hardware (and EPL_NO_FMA is not defined); the evaluator then computes
+ * a * b + c on floating point arrays as one fused operation (see FmaProxy).
+ * fma_lanes(a, b, c) is that operation on every lane.
+ */
+#if !defined(EPL_NO_FMA) && (defined(__FMA__) || defined(FP_FAST_FMA))
+#define EPL_FMA 1
+#endif
+
+#if EPL_SIMD_BYTES > 0
+#if EPL_SIMD_BYTES == 64 && defined(__AVX512F__)
+inline packet<double> fma_lanes(const packet<double>& a, const packet<double>& b, const packet<double>& c) { return (packet<double>) _mm512_fmadd_pd((__m512d) a, (__m512d) b, (__m512d) c); }
+inline packet<float> fma_lanes(const packet<float>& a, const packet<float>& b, const packet<float>& c) { return (packet<float>) _mm512_fmadd_ps((__m512) a, (__m512) b, (__m512) c); }
+#elif EPL_SIMD_BYTES == 32 && defined(__FMA__)
+inline packet<double> fma_lanes(const packet<double>& a, const packet<double>& b, const packet<double>& c) { return (packet<double>) _mm256_fmadd_pd((__m256d) a, (__m256d) b, (__m256d) c); }
+inline packet<float> fma_lanes(const packet<float>& a, const packet<float>& b, const packet<float>& c) { return (packet<float>) _mm256_fmadd_ps((__m256) a, (__m256) b, (__m256) c); }
+#elif EPL_SIMD_BYTES == 16 && defined(__FMA__)
+inline packet<double> fma_lanes(const packet<double>& a, const packet<double>& b, const packet<double>& c) { return (packet<double>) _mm_fmadd_pd((__m128d) a, (__m128d) b, (__m128d) c); }
+inline packet<float> fma_lanes(const packet<float>& a, const packet<float>& b, const packet<float>& c) { return (packet<float>) _mm_fmadd_ps((__m128) a, (__m128) b, (__m128) c); }
+#else
+template <typename T>
+inline packet<T> fma_lanes_loop(const packet<T>& a, const packet<T>& b, const packet<T>& c) {
+	packet<T> result = {};
+	for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+		result[k] = std::fma(a[k], b[k], c[k]);
+	}
+	return result;
+}
+
+inline packet<double> fma_lanes(const packet<double>& a, const packet<double>& b, const packet<double>& c) { return fma_lanes_loop<double>(a, b, c); }
+inline packet<float> fma_lanes(const packet<float>& a, const packet<float>& b, const packet<float>& c) { return fma_lanes_loop<float>(a, b, c); }
+#endif
+#endif
+
+/*
+ * mulhi_lanes(a, b) is the high half of the 64 bit product of every lane of
+ * a with b, the step of integer division by a multiplication. x86 multiplies
+ * the even lanes into 64 bit products; the odd lanes go through a shift.
+ */
+#if EPL_SIMD_BYTES > 0
+#if EPL_SIMD_BYTES == 64 && defined(__AVX512F__)
+inline packet<int> mulhi_lanes(const packet<int>& a, int32_t b) {
+	__m512i x = (__m512i) a, m = _mm512_set1_epi32(b);
+	/* masked forms, as for sqrt_lanes */
+	__m512i even = _mm512_mask_srli_epi64(x, (__mmask8) -1, _mm512_mask_mul_epi32(x, (__mmask8) -1, x, m), 32);
+	__m512i odd = _mm512_mask_mul_epi32(x, (__mmask8) -1, _mm512_mask_srli_epi64(x, (__mmask8) -1, x, 32), m);
+	return (packet<int>) _mm512_mask_blend_epi32((__mmask16) 0xAAAA, even, odd);
+}
+#elif EPL_SIMD_BYTES == 32 && defined(__AVX2__)
+inline packet<int> mulhi_lanes(const packet<int>& a, int32_t b) {
+	__m256i x = (__m256i) a, m = _mm256_set1_epi32(b);
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epi32(x, m), 32);
+	__m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), m);
+	return (packet<int>) _mm256_blend_epi32(even, odd, 0xAA);
+}
+#elif EPL_SIMD_BYTES == 16 && defined(__SSE4_1__)
+inline packet<int> mulhi_lanes(const packet<int>& a, int32_t b) {
+	__m128i x = (__m128i) a, m = _mm_set1_epi32(b);
+	__m128i even = _mm_srli_epi64(_mm_mul_epi32(x, m), 32);
+	__m128i odd = _mm_mul_epi32(_mm_srli_epi64(x, 32), m);
+	return (packet<int>) _mm_blend_epi16(even, odd, 0xCC);
+}
+#elif EPL_SIMD_BYTES == 16 && defined(__SSE2__)
+/* SSE2 multiplies unsigned lanes only; the signed high half subtracts b where a < 0 and a where b < 0 */
+inline packet<int> mulhi_lanes(const packet<int>& a, int32_t b) {
+	__m128i x = (__m128i) a, m = _mm_set1_epi32(b);
+	__m128i even = _mm_srli_epi64(_mm_mul_epu32(x, m), 32);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), m);
+	__m128i high = _mm_or_si128(even, _mm_and_si128(odd, _mm_set_epi32(-1, 0, -1, 0)));
+	__m128i fix = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(x, 31), m), b < 0 ? x : _mm_setzero_si128());
+	return (packet<int>) _mm_sub_epi32(high, fix);
+}
+#else
+inline packet<int> mulhi_lanes(const packet<int>& a, int32_t b) {
+	packet<int> result = {};
+	for (uint64_t k = 0; k < packet_traits<int>::size; ++k) {
+		result[k] = (int) ((int64_t) a[k] * b >> 32);
+	}
+	return result;
+}
+#endif
+#endif
+
+/*
+ * complex_packet<T> holds size lanes of std::complex<T> split into a packet of
+ * real parts and a packet of imaginary parts, so complex arithmetic is plain
+ * arithmetic on real packets. Arrays of std::complex are deinterleaved on
+ * load and interleaved on store; split storage (complex_valarray) loads and
+ * stores each plane directly. Lanes read and assign as std::complex<T>.
+ */
+template <typename T>
+struct complex_packet {
+	packet<T> re;
+	packet<T> im;
+
+	struct lane {
+		complex_packet& owner;
+		uint64_t k;
+
+		operator std::complex<T>() const { return std::complex<T>(owner.re[k], owner.im[k]); }
+
+		lane& operator=(const std::complex<T>& value) {
+			owner.re[k] = value.real();
+			owner.im[k] = value.imag();
+			return *this;
+		}
+
+		lane& operator=(const lane& that) { return *this = std::complex<T>(that); }
+	};
+
+	lane operator[](uint64_t k) { return lane{*this, k}; }
+
+	std::complex<T> operator[](uint64_t k) const { return std::complex<T>(re[k], im[k]); }
+};
+
+/* only floating point complex numbers have packets, as wide as those of T */
+template <typename T>
+struct packet_traits<std::complex<T>> {
+	static constexpr bool vectorizable = packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+	static constexpr uint64_t size = vectorizable ? packet_traits<T>::size : 1;
+	using type = typename std::conditional<vectorizable, complex_packet<T>, std::complex<T>>::type;
+};
+
+#if EPL_SIMD_BYTES > 0
+template <typename T>
+inline complex_packet<T> load_packet(const std::complex<T>* p) {
+	complex_packet<T> result = {};
+	for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+		result.re[k] = p[k].real();
+		result.im[k] = p[k].imag();
+	}
+	return result;
+}
+
+template <typename T>
+inline void store_packet(std::complex<T>* p, const complex_packet<T>& value) {
+	for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+		p[k] = value[k];
+	}
+}
+
+template <typename T>
+inline complex_packet<T> broadcast_packet(const std::complex<T>& value) {
+	return complex_packet<T>{broadcast_packet(value.real()), broadcast_packet(value.imag())};
+}
+
+/*
+ * Complex arithmetic on packets gives the results std::complex gives (with
+ * GCC's libgcc), lane for lane, as long as the compiler does not contract
+ * a * b + c into fused multiply-adds. Under -mfma (which -march=native and
+ * -mavx512f imply) it does, and products and quotients then differ from
+ * std::complex by one or two ulps in many lanes, a quarter of random quotients.
+ *     a * b    the textbook formula; lanes where both parts come out NaN are
+ *              redone by std::complex, which recovers infinities (C99 Annex G)
+ *     a / b    Smith's algorithm for double, as __divdc3 uses for operands
+ *              away from the ends of the exponent range, and the textbook
+ *              formula evaluated in double for float, as __divsc3 does;
+ *              lanes near either end of the range (which __divdc3 scales),
+ *              and lanes with a quotient that is not finite, are redone by
+ *              std::complex
+ *     abs(z)   sqrt(re^2 + im^2), computed in double for float; within an ulp
+ *              of std::abs, lanes where the squares overflow or underflow use it
+ *     sqrt(z)  from abs(z), within a few ulps of std::sqrt; zero, subnormal
+ *              and non-finite lanes use std::sqrt
+ * Defining EPL_FAST_COMPLEX skips the recovery in a * b and divides by
+ * |b|^2 directly in a / b, like -fcx-limited-range: faster, but infinite or
+ * NaN operands can give NaN where std::complex would not, and quotients
+ * overflow or underflow for |b| beyond the square root of the range of T.
+ */
+template <typename T>
+inline complex_packet<T> operator+(const complex_packet<T>& a, const complex_packet<T>& b) {
+	return complex_packet<T>{a.re + b.re, a.im + b.im};
+}
+
+template <typename T>
+inline complex_packet<T> operator-(const complex_packet<T>& a, const complex_packet<T>& b) {
+	return complex_packet<T>{a.re - b.re, a.im - b.im};
+}
+
+template <typename T>
+inline complex_packet<T> operator-(const complex_packet<T>& a) {
+	return complex_packet<T>{-a.re, -a.im};
+}
+
+template <typename T>
+inline complex_packet<T> operator*(const complex_packet<T>& a, const complex_packet<T>& b) {
+	complex_packet<T> result = {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+#ifndef EPL_FAST_COMPLEX
+	auto lost = (result.re != result.re) & (result.im != result.im);
+	if (any_lane(lost)) {
+		for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+			if (lost[k]) { result[k] = a[k] * b[k]; }
+		}
+	}
+#endif
+	return result;
+}
+
+#ifdef EPL_FAST_COMPLEX
+template <typename T>
+inline complex_packet<T> operator/(const complex_packet<T>& a, const complex_packet<T>& b) {
+	packet<T> scale = broadcast_packet(T(1)) / (b.re * b.re + b.im * b.im);
+	return complex_packet<T>{(a.re * b.re + a.im * b.im) * scale, (a.im * b.re - a.re * b.im) * scale};
+}
+#else
+/* redoes with std::complex the lanes of a / b whose quotient is not finite */
+template <typename T, typename M>
+inline complex_packet<T> divide_lanes(const complex_packet<T>& a, const complex_packet<T>& b, complex_packet<T> result, M redo) {
+	// x - x is NaN for infinite and NaN x, zero otherwise
+	const packet<T> zero = {};
+	redo |= (result.re - result.re != zero) | (result.im - result.im != zero);
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+			if (redo[k]) { result[k] = a[k] / b[k]; }
+		}
+	}
+	return result;
+}
+
+template <typename T>
+inline complex_packet<T> operator/(const complex_packet<T>& a, const complex_packet<T>& b) {
+	// divide by the larger part of b: with p the smaller one and q the larger
+	// (x, y) = (a.re * r + a.im, a.im * r - a.re) / (p * r + q), r = p / q, if |b.re| < |b.im|
+	// (x, y) = (a.im * r + a.re, a.im - a.re * r) / (p * r + q), r = p / q, otherwise
+	const packet<T> zero = {};
+	auto small = (b.re < zero ? -b.re : b.re) < (b.im < zero ? -b.im : b.im);
+	packet<T> p = small ? b.re : b.im;
+	packet<T> q = small ? b.im : b.re;
+	packet<T> u = small ? a.re : a.im;
+	packet<T> v = small ? a.im : a.re;
+	packet<T> ratio = p / q;
+	packet<T> denominator = p * ratio + q;
+	packet<T> y = small ? v * ratio - u : u - v * ratio;
+	complex_packet<T> result = {(u * ratio + v) / denominator, y / denominator};
+
+	// __divdc3 scales operands near either end of the exponent range, where
+	// p * ratio + q can overflow to a finite but wrong quotient and subnormal
+	// parts lose bits, and reorders the evaluation for a subnormal (or
+	// underflowed) ratio: such lanes are redone
+	const packet<T> tiny = broadcast_packet(std::numeric_limits<T>::min());
+	auto subnormal = [&](const packet<T>& x) { return (x != zero) & (x < tiny) & (-x < tiny); };
+	auto underflows = [&](const packet<T>& x) { packet<T> xr = x * ratio; return (x != zero) & (ratio != zero) & (xr < tiny) & (-xr < tiny); };
+	packet<T> magnitude = q < zero ? -q : q;
+	auto extreme = (magnitude >= broadcast_packet(std::numeric_limits<T>::max() / 2))
+		| (magnitude < broadcast_packet(std::numeric_limits<T>::epsilon()))
+		| (denominator - denominator != zero);
+	auto redo = extreme | ((p != zero) & ((ratio < tiny) & (-ratio < tiny)))
+		| subnormal(u) | subnormal(v) | underflows(u) | underflows(v);
+	return divide_lanes(a, b, result, redo);
+}
+
+inline complex_packet<float> operator/(const complex_packet<float>& a, const complex_packet<float>& b) {
+	complex_packet<float> result = {};
+	for (uint64_t k = 0; k < packet_traits<float>::size; ++k) {
+		double denominator = (double) b.re[k] * b.re[k] + (double) b.im[k] * b.im[k];
+		result.re[k] = (float) (((double) a.re[k] * b.re[k] + (double) a.im[k] * b.im[k]) / denominator);
+		result.im[k] = (float) (((double) a.im[k] * b.re[k] - (double) a.re[k] * b.im[k]) / denominator);
+	}
+	return divide_lanes(a, b, result, result.re != result.re);
+}
+#endif
+
+template <typename T>
+inline packet<T> abs(const complex_packet<T>& z) {
+	const packet<T> zero = {};
+	packet<T> squares = z.re * z.re + z.im * z.im;
+	packet<T> result = sqrt_lanes(squares);
+	auto redo = (squares != squares) | (squares > broadcast_packet(std::numeric_limits<T>::max()));
+	redo |= (squares < broadcast_packet(std::numeric_limits<T>::min())) & ((z.re != zero) | (z.im != zero));
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+			if (redo[k]) { result[k] = std::abs(z[k]); }
+		}
+	}
+	return result;
+}
+
+inline packet<float> abs(const complex_packet<float>& z) {
+	packet<float> result = {};
+	for (uint64_t k = 0; k < packet_traits<float>::size; ++k) {
+		result[k] = (float) std::sqrt((double) z.re[k] * z.re[k] + (double) z.im[k] * z.im[k]);
+	}
+	auto redo = (result != result) | (result > broadcast_packet(std::numeric_limits<float>::max()));
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<float>::size; ++k) {
+			if (redo[k]) { result[k] = std::abs(z[k]); }
+		}
+	}
+	return result;
+}
+
+template <typename T>
+inline complex_packet<T> sqrt(const complex_packet<T>& z) {
+	// t = sqrt((|z| + |re|) / 2); sqrt(z) = (t, im / 2t) for re >= 0, (|im| / 2t, +-t) otherwise
+	const packet<T> zero = {};
+	packet<T> magnitude = abs(z);
+	packet<T> t = sqrt_lanes((magnitude + (z.re < zero ? -z.re : z.re)) * broadcast_packet(T(0.5)));
+	packet<T> s = z.im / (t + t);
+	auto positive = z.re >= zero;
+	complex_packet<T> result = {positive ? t : (s < zero ? -s : s), positive ? s : (z.im < zero ? -t : t)};
+
+	// the sign of a zero imaginary part picks the side of the branch cut, and
+	// halving a subnormal |z| loses its low bits
+	auto redo = (t == zero) | (t - t != zero) | (~positive & (z.im == zero))
+		| (magnitude < broadcast_packet(std::numeric_limits<T>::min()));
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+			if (redo[k]) { result[k] = std::sqrt(z[k]); }
+		}
+	}
+	return result;
+}
+#endif
+
+/*
+ * boolean<T> is the truth of a comparison of two T, as an element: a bool that
+ * keeps the width of the values it came from. Its packet is what comparing two
+ * packets of T gives, integers as wide as T that are all ones in the lanes
+ * where the comparison holds, so masks blend packets of T without branches.
+ */
+template <typename T>
+struct boolean {
+	bool value;
+
+	boolean() = default;
+
+	boolean(bool _value) : value(_value) {}
+
+	template <typename U>
+	boolean(const boolean<U>& that) : value(that.value) {}
+
+	operator bool() const { return value; }
+};
+
+template <typename T>
+struct is_boolean : public std::false_type {};
+
+template <typename T>
+struct is_boolean<boolean<T>> : public std::true_type {};
+
+template <typename T, bool = packet_traits<T>::vectorizable && std::is_arithmetic<T>::value>
+struct boolean_packet {
+	static constexpr bool vectorizable = false;
+	using type = boolean<T>;
+};
+
+template <typename T>
+struct boolean_packet<T, true> {
+	static constexpr bool vectorizable = true;
+	using type = decltype(packet<T>{} < packet<T>{});
+};
+
+template <typename T>
+struct packet_traits<boolean<T>> {
+	static constexpr bool vectorizable = boolean_packet<T>::vectorizable;
+	static constexpr uint64_t size = vectorizable ? packet_traits<T>::size : 1;
+	using type = typename boolean_packet<T>::type;
+};
+
+/* whether an element counts as true: booleans as they are, anything else when nonzero */
+template <typename T>
+inline bool truth(const T& x) { return x != T(0); }
+
+template <typename T>
+inline bool truth(const boolean<T>& x) { return x.value; }
+
+/*
+ * packet_op<Operator> describes how a scalar functor is applied to whole packets.
+ * value is true only when the functor reads and produces value_type, so a
+ * packet of arguments maps onto a packet of results without conversions.
+ */
+template <typename Operator>
+struct packet_op {
+	static constexpr bool value = false;
+	using value_type = void;
+};
+
+template <typename T>
+struct packet_op<std::plus<T>> {
+	static constexpr bool value = packet_traits<T>::vectorizable;
+	using value_type = T;
+	static packet<T> apply(const std::plus<T>&, const packet<T>& a, const packet<T>& b) { return a + b; }
+};
+
+template <typename T>
+struct packet_op<std::minus<T>> {
+	static constexpr bool value = packet_traits<T>::vectorizable;
+	using value_type = T;
+	static packet<T> apply(const std::minus<T>&, const packet<T>& a, const packet<T>& b) { return a - b; }
+};
+
+template <typename T>
+struct packet_op<std::multiplies<T>> {
+	static constexpr bool value = packet_traits<T>::vectorizable;
+	using value_type = T;
+	static packet<T> apply(const std::multiplies<T>&, const packet<T>& a, const packet<T>& b) { return a * b; }
+};
+
+template <typename T>
+struct packet_op<std::divides<T>> {
+	static constexpr bool value = packet_traits<T>::vectorizable;
+	using value_type = T;
+	static packet<T> apply(const std::divides<T>&, const packet<T>& a, const packet<T>& b) { return a / b; }
+};
+
+template <typename T>
+struct packet_op<std::negate<T>> {
+	static constexpr bool value = packet_traits<T>::vectorizable;
+	using value_type = T;
+	static packet<T> apply(const std::negate<T>&, const packet<T>& a) { return -a; }
+};
+
+/*
+ * operation_cost<Operator>::value is the cost of one application of a
+ * functor, in additions, for the evaluator's cost model. Division and square
+ * root have a latency and throughput several times that of the others.
+ */
+template <typename Operator>
+struct operation_cost {
+	static constexpr uint64_t value = 1;
+};
+
+template <typename T>
+struct operation_cost<std::divides<T>> {
+	static constexpr uint64_t value = 8;
+};
+
+/* a complex product is four multiplications and two additions; a quotient adds three divisions */
+template <typename T>
+struct operation_cost<std::multiplies<std::complex<T>>> {
+	static constexpr uint64_t value = 6;
+};
+
+template <typename T>
+struct operation_cost<std::divides<std::complex<T>>> {
+	static constexpr uint64_t value = 30;
+};
+
+/*
+ * reduction_traits<Operator> marks the functors a reduction may regroup:
+ * associative ones can be split into independent partial results (one per
+ * packet lane, accumulator and thread) that start from identity() and are
+ * combined afterwards. Floating point addition is treated as associative;
+ * the evaluator's deterministic mode keeps the grouping reproducible.
+ */
+template <typename Operator>
+struct reduction_traits {
+	static constexpr bool associative = false;
+};
+
+template <typename T>
+struct reduction_traits<std::plus<T>> {
+	static constexpr bool associative = true;
+	static T identity(void) { return T(0); }
+};
+
+template <typename T>
+struct reduction_traits<std::multiplies<T>> {
+	static constexpr bool associative = true;
+	static T identity(void) { return T(1); }
+};
+
+} //epl namespace
+
+#endif /* _Packet_h */
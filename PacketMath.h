@@ -0,0 +1,346 @@
+/*
+ * PacketMath.h
+ *
+ * Elementary functions on packets of double and float, for the lazy exp(),
+ * log(), sin(), ... of Valarray.h. Each reduces its argument to a short
+ * interval, evaluates a polynomial there for the whole packet and rebuilds
+ * the result; lanes outside the range the reduction covers (NaN, infinities,
+ * zeros and negatives for log, |x| >= 2^24 for sin and cos, ...) are redone
+ * by <cmath>, so special values are exactly those of the C library.
+ *
+ * Largest errors against the correctly rounded result, in ulps, measured on
+ * millions of arguments spread over each function's range:
+ *     exp_lanes, log_lanes     1      abs, floor, ceil_lanes       exact
+ *     sin_lanes, cos_lanes     2.5    float lanes, pow included    1
+ *     tanh_lanes               1.5    pow_lanes on double          libm
+ * float lanes are evaluated by the double kernels and rounded once more.
+ * Lanes of pow on double call std::pow: exp(y log x) in double loses about
+ * |y log x| ulps, and doing better needs log x to more than double precision.
+ * The reductions rely on IEEE rounding and are broken by -ffast-math.
+ *
+ * Define EPL_STRICT_LIBM to have every element computed by <cmath> instead;
+ * expressions also do so below AVX (see elementary_packets_enabled).
+ */
+
+#ifndef _PacketMath_h
+#define _PacketMath_h
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "Packet.h"
+
+namespace epl {
+
+/* whether expressions use these kernels: not with EPL_STRICT_LIBM, and not for
+ * 16-byte packets, whose two doubles lose to glibc's table-driven scalar code */
+#if defined(EPL_STRICT_LIBM) || EPL_SIMD_BYTES < 32
+constexpr bool elementary_packets_enabled = false;
+#else
+constexpr bool elementary_packets_enabled = true;
+#endif
+
+#if EPL_SIMD_BYTES > 0
+
+/* a packet of the integers as wide as T, for the bits of a packet of T */
+template <typename T>
+struct bits_traits;
+
+template <>
+struct bits_traits<float> {
+	using scalar = int32_t;
+	typedef int32_t type __attribute__((vector_size(EPL_SIMD_BYTES)));
+	static constexpr int mantissa = 23;
+	static constexpr int32_t bias = 127;
+};
+
+template <>
+struct bits_traits<double> {
+	using scalar = int64_t;
+	typedef int64_t type __attribute__((vector_size(EPL_SIMD_BYTES)));
+	static constexpr int mantissa = 52;
+	static constexpr int64_t bias = 1023;
+};
+
+template <typename T>
+using bits = typename bits_traits<T>::type;
+
+template <typename T>
+inline bits<T> to_bits(const packet<T>& x) {
+	bits<T> result;
+	std::memcpy(&result, &x, sizeof(result));
+	return result;
+}
+
+template <typename T>
+inline packet<T> from_bits(const bits<T>& b) {
+	packet<T> result;
+	std::memcpy(&result, &b, sizeof(result));
+	return result;
+}
+
+/* 1.5 * 2^mantissa: in x + round_magic, |x| < 2^(mantissa - 1) is rounded to
+ * the nearest integer, which the low bits of the sum then hold */
+template <typename T>
+inline T round_magic(void) {
+	return T(1.5) * T(typename bits_traits<T>::scalar(1) << bits_traits<T>::mantissa);
+}
+
+/* c[0] + c[1] x + c[2] x^2 + ..., by Horner's rule */
+template <typename T, uint64_t N>
+inline packet<T> polynomial(const packet<T>& x, const T (&c)[N]) {
+	packet<T> result = broadcast_packet(c[N - 1]);
+	for (uint64_t k = N - 1; k-- > 0;) {
+		result = result * x + c[k];
+	}
+	return result;
+}
+
+/* recomputes with f the lanes where redo holds */
+template <typename T, typename M, typename F>
+inline packet<T> redo_lanes(const packet<T>& x, packet<T> result, const M& redo, F f) {
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<T>::size; ++k) {
+			if (redo[k]) { result[k] = f(x[k]); }
+		}
+	}
+	return result;
+}
+
+/* f on the lanes of x converted to double, in two packets, rounded back to float */
+template <typename F>
+inline packet<float> widened(const packet<float>& x, F f) {
+	const uint64_t half = packet_traits<double>::size;
+	packet<double> lo = {}, hi = {};
+	for (uint64_t k = 0; k < half; ++k) {
+		lo[k] = x[k];
+		hi[k] = x[half + k];
+	}
+	lo = f(lo);
+	hi = f(hi);
+	packet<float> result = {};
+	for (uint64_t k = 0; k < half; ++k) {
+		result[k] = (float) lo[k];
+		result[half + k] = (float) hi[k];
+	}
+	return result;
+}
+
+template <typename T>
+inline packet<T> clear_sign(const packet<T>& x) {
+	const bits<T> sign = {};
+	return from_bits<T>(to_bits<T>(x) & ~(sign | std::numeric_limits<typename bits_traits<T>::scalar>::min()));
+}
+
+/* floor (Up false) or ceil (Up true) of every lane: |x| rounded to the nearest
+ * integer, given the sign of x and moved by one towards -inf or +inf where
+ * that went past x; from 2^mantissa on every T is an integer already */
+template <typename T, bool Up>
+inline packet<T> round_lanes(const packet<T>& x) {
+	const T big = T(typename bits_traits<T>::scalar(1) << bits_traits<T>::mantissa);
+	packet<T> a = clear_sign<T>(x);
+	bits<T> sign = to_bits<T>(x) & std::numeric_limits<typename bits_traits<T>::scalar>::min();
+	packet<T> r = from_bits<T>(to_bits<T>((a + big) - big) | sign);
+	if (Up) {
+		r = r < x ? r + T(1) : r;
+	} else {
+		r = r > x ? r - T(1) : r;
+	}
+	return a < big ? r : x;
+}
+
+inline packet<int> abs_lanes(const packet<int>& x) { return x < 0 ? -x : x; }
+inline packet<float> abs_lanes(const packet<float>& x) { return clear_sign<float>(x); }
+inline packet<double> abs_lanes(const packet<double>& x) { return clear_sign<double>(x); }
+inline packet<float> floor_lanes(const packet<float>& x) { return round_lanes<float, false>(x); }
+inline packet<double> floor_lanes(const packet<double>& x) { return round_lanes<double, false>(x); }
+inline packet<float> ceil_lanes(const packet<float>& x) { return round_lanes<float, true>(x); }
+inline packet<double> ceil_lanes(const packet<double>& x) { return round_lanes<double, true>(x); }
+
+/* exp(x) = 2^n exp(r), r = x - n ln 2 in [-ln 2 / 2, ln 2 / 2], exp(r) by its Taylor series */
+inline packet<double> exp_lanes(const packet<double>& x) {
+	static const double coefficients[] = {
+		1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880,
+		1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800
+	};
+	// ln 2 in two parts, the first with trailing zeros so that n * ln2_hi is exact
+	const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+	const double magic = round_magic<double>();
+	packet<double> t = x * 1.44269504088896340736 + magic;
+	packet<double> n = t - magic;
+	bits<double> k = to_bits<double>(t) - to_bits<double>(broadcast_packet(magic));
+	packet<double> r = (x - n * ln2_hi) - n * ln2_lo;
+	packet<double> p = 1.0 + (r + r * r * polynomial(r, coefficients));
+	packet<double> result = p * from_bits<double>((k + bits_traits<double>::bias) << bits_traits<double>::mantissa);
+
+	// keeps 2^n normal; overflow, underflow and NaN are left to std::exp
+	auto redo = ~((x > -708.0) & (x < 708.0));
+	return redo_lanes<double>(x, result, redo, [](double v) { return std::exp(v); });
+}
+
+/* log(x) = e ln 2 + log(1 + f), 1 + f = x / 2^e in [sqrt(1/2), sqrt(2)),
+ * log(1 + f) = 2 atanh(s), s = f / (2 + f), as in fdlibm */
+inline packet<double> log_lanes(const packet<double>& x) {
+	static const double coefficients[] = {
+		2.0 / 3, 2.0 / 5, 2.0 / 7, 2.0 / 9, 2.0 / 11, 2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19, 2.0 / 21
+	};
+	const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10;
+	const double magic = round_magic<double>();
+	const bits<double> b = to_bits<double>(x);
+	const bits<double> fraction = (bits<double>{} | 1) << bits_traits<double>::mantissa;
+	bits<double> e = (b >> bits_traits<double>::mantissa) - bits_traits<double>::bias;
+	packet<double> m = from_bits<double>((b & (fraction - 1)) | to_bits<double>(broadcast_packet(1.0)));
+	auto above = m > 1.41421356237309504880;
+	m = above ? m * 0.5 : m;
+	e -= above;
+	packet<double> dk = from_bits<double>(e + to_bits<double>(broadcast_packet(magic))) - magic;
+
+	packet<double> f = m - 1.0;
+	packet<double> s = f / (2.0 + f);
+	packet<double> z = s * s;
+	packet<double> R = z * polynomial(z, coefficients);
+	packet<double> hfsq = 0.5 * f * f;
+	packet<double> result = dk * ln2_hi - ((hfsq - (s * (hfsq + R) + dk * ln2_lo)) - f);
+
+	// zeros, negatives, subnormals, infinities and NaN are left to std::log
+	auto redo = ~((x >= std::numeric_limits<double>::min()) & (x <= std::numeric_limits<double>::max()));
+	return redo_lanes<double>(x, result, redo, [](double v) { return std::log(v); });
+}
+
+/* x - q pi/2 for q the integer nearest x 2/pi, with pi/2 in four parts; the
+ * first three have trailing zeros so that the products are exact for |x| < 2^24 */
+inline packet<double> reduce_quadrant(const packet<double>& x, bits<double>& q) {
+	const double pio2_1 = 1.570796325802803, pio2_2 = 9.920935808982456e-10;
+	const double pio2_3 = -1.2177051748566079e-18, pio2_4 = -2.940788670387328e-27;
+	const double magic = round_magic<double>();
+	packet<double> t = x * 0.63661977236758134308 + magic;
+	packet<double> n = t - magic;
+	q = to_bits<double>(t) - to_bits<double>(broadcast_packet(magic));
+	return (((x - n * pio2_1) - n * pio2_2) - n * pio2_3) - n * pio2_4;
+}
+
+/* sin(r) and cos(r) for |r| <= pi/4, by their Taylor series */
+inline packet<double> sin_reduced(const packet<double>& r) {
+	static const double coefficients[] = {
+		-1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800, 1.0 / 6227020800,
+		-1.0 / 1307674368000, 1.0 / 355687428096000
+	};
+	packet<double> z = r * r;
+	return r + r * z * polynomial(z, coefficients);
+}
+
+inline packet<double> cos_reduced(const packet<double>& r) {
+	static const double coefficients[] = {
+		1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800, 1.0 / 479001600, -1.0 / 87178291200,
+		1.0 / 20922789888000
+	};
+	// 1 - z/2 summed so that the rounding of w = 1 - z/2 is recovered, as fdlibm does
+	packet<double> z = r * r;
+	packet<double> hz = 0.5 * z;
+	packet<double> w = 1.0 - hz;
+	return w + (((1.0 - w) - hz) + z * z * polynomial(z, coefficients));
+}
+
+inline packet<double> sin_lanes(const packet<double>& x) {
+	bits<double> q;
+	packet<double> r = reduce_quadrant(x, q);
+	packet<double> s = sin_reduced(r), c = cos_reduced(r);
+	packet<double> result = (q & 1) != 0 ? c : s;
+	result = (q & 2) != 0 ? -result : result;
+	result = x == 0.0 ? x : result; // keeps the sign of zero
+
+	// beyond 2^24 the reduction needs more of pi than four doubles
+	auto redo = ~(abs_lanes(x) < 16777216.0);
+	return redo_lanes<double>(x, result, redo, [](double v) { return std::sin(v); });
+}
+
+inline packet<double> cos_lanes(const packet<double>& x) {
+	bits<double> q;
+	packet<double> r = reduce_quadrant(x, q);
+	packet<double> s = sin_reduced(r), c = cos_reduced(r);
+	packet<double> result = (q & 1) != 0 ? s : c;
+	result = ((q + 1) & 2) != 0 ? -result : result;
+
+	auto redo = ~(abs_lanes(x) < 16777216.0);
+	return redo_lanes<double>(x, result, redo, [](double v) { return std::cos(v); });
+}
+
+/* x + x^3 P(x^2) / Q(x^2) below 0.625 (Cephes), 1 - 2 / (exp(2|x|) + 1) above */
+inline packet<double> tanh_lanes(const packet<double>& x) {
+	static const double P[] = { -1.61468768441708447952E3, -9.92877231001918586564E1, -9.64399179425052238628E-1 };
+	static const double Q[] = { 4.84406305325125486048E3, 2.23548839060100448583E3, 1.12811678491632931402E2, 1.0 };
+	packet<double> a = abs_lanes(x);
+	packet<double> z = x * x;
+	packet<double> small = x + x * z * (polynomial(z, P) / polynomial(z, Q));
+
+	// tanh is 1 to double precision from 20 on, and exp is kept in range
+	packet<double> e = exp_lanes(a < 20.0 ? a + a : broadcast_packet(40.0));
+	packet<double> large = 1.0 - 2.0 / (e + 1.0);
+	large = from_bits<double>(to_bits<double>(large) | (to_bits<double>(x) & std::numeric_limits<int64_t>::min()));
+	packet<double> result = a < 0.625 ? small : large;
+	result = x == 0.0 ? x : result;
+	return redo_lanes<double>(x, result, x != x, [](double v) { return std::tanh(v); });
+}
+
+inline packet<double> pow_lanes(const packet<double>& x, const packet<double>& y) {
+	packet<double> result = {};
+	for (uint64_t k = 0; k < packet_traits<double>::size; ++k) {
+		result[k] = std::pow(x[k], y[k]);
+	}
+	return result;
+}
+
+inline packet<float> exp_lanes(const packet<float>& x) {
+	return widened(x, [](const packet<double>& w) { return exp_lanes(w); });
+}
+
+inline packet<float> log_lanes(const packet<float>& x) {
+	return widened(x, [](const packet<double>& w) { return log_lanes(w); });
+}
+
+inline packet<float> sin_lanes(const packet<float>& x) {
+	return widened(x, [](const packet<double>& w) { return sin_lanes(w); });
+}
+
+inline packet<float> cos_lanes(const packet<float>& x) {
+	return widened(x, [](const packet<double>& w) { return cos_lanes(w); });
+}
+
+inline packet<float> tanh_lanes(const packet<float>& x) {
+	return widened(x, [](const packet<double>& w) { return tanh_lanes(w); });
+}
+
+/* exp(y log x) in double is well within a float ulp; x <= 0 and non-finite operands use std::pow */
+inline packet<float> pow_lanes(const packet<float>& x, const packet<float>& y) {
+	const uint64_t half = packet_traits<double>::size;
+	packet<double> x_lo = {}, x_hi = {}, y_lo = {}, y_hi = {};
+	for (uint64_t k = 0; k < half; ++k) {
+		x_lo[k] = x[k];
+		x_hi[k] = x[half + k];
+		y_lo[k] = y[k];
+		y_hi[k] = y[half + k];
+	}
+	packet<double> lo = exp_lanes(y_lo * log_lanes(x_lo));
+	packet<double> hi = exp_lanes(y_hi * log_lanes(x_hi));
+	packet<float> result = {};
+	for (uint64_t k = 0; k < half; ++k) {
+		result[k] = (float) lo[k];
+		result[half + k] = (float) hi[k];
+	}
+
+	const float max = std::numeric_limits<float>::max();
+	auto redo = ~((x > 0.0f) & (x <= max) & (y >= -max) & (y <= max));
+	if (any_lane(redo)) {
+		for (uint64_t k = 0; k < packet_traits<float>::size; ++k) {
+			if (redo[k]) { result[k] = std::pow(x[k], y[k]); }
+		}
+	}
+	return result;
+}
+#endif
+
+} //epl namespace
+
+#endif /* _PacketMath_h */
@@ -0,0 +1,214 @@
+/*
+ * ThreadPool.h
+ *
+ * The persistent worker pool used to evaluate large expressions in parallel.
+ * Workers are started the first time the pool is used and live until the
+ * program exits; the thread that submits a job works on it too.
+ */
+
+#ifndef _ThreadPool_h
+#define _ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace epl {
+
+class thread_pool {
+private:
+	std::vector<std::thread> workers;
+	std::atomic<unsigned> worker_count{0}; // workers.size(), readable without submit_mutex
+
+	std::mutex submit_mutex; // one job in flight at a time
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(uint64_t)>* job = nullptr;
+	uint64_t job_tasks = 0;
+	std::atomic<uint64_t> next_task{0};
+	uint64_t busy_workers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+	std::exception_ptr failure;
+
+	static bool& inside_job(void) {
+		static thread_local bool flag = false;
+		return flag;
+	}
+
+public:
+	explicit thread_pool(unsigned threads) { start(threads); }
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	~thread_pool(void) { stop(); }
+
+	/* the pool shared by every valarray expression */
+	static thread_pool& global(void) {
+		static thread_pool pool(default_concurrency());
+		return pool;
+	}
+
+	/* EPL_NUM_THREADS overrides the hardware concurrency */
+	static unsigned default_concurrency(void) {
+		if (const char* env = std::getenv("EPL_NUM_THREADS")) {
+			int n = std::atoi(env);
+			if (n > 0) { return (unsigned) n; }
+		}
+		unsigned n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+	/* number of threads working on a job, including the submitting thread */
+	unsigned concurrency(void) const { return worker_count + 1; }
+
+	void resize(unsigned threads) {
+		std::lock_guard<std::mutex> guard(submit_mutex);
+		stop();
+		start(threads);
+	}
+
+	/*
+	 * calls task(0) ... task(tasks - 1), spread across the pool, and returns
+	 * once all of them have finished. Jobs submitted from inside a task run
+	 * serially on the calling thread. The first exception thrown by a task is
+	 * rethrown here after the remaining tasks complete.
+	 */
+	void run(uint64_t tasks, const std::function<void(uint64_t)>& task) {
+		if (tasks == 0) { return; }
+		if (tasks == 1 || worker_count == 0 || inside_job()) {
+			for (uint64_t k = 0; k < tasks; k += 1) { task(k); }
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(submit_mutex);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &task;
+			job_tasks = tasks;
+			next_task = 0;
+			busy_workers = workers.size();
+			failure = nullptr;
+			++generation;
+		}
+		wake.notify_all();
+
+		drain(task);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busy_workers == 0; });
+		job = nullptr;
+		if (failure) {
+			std::exception_ptr e = failure;
+			failure = nullptr;
+			std::rethrow_exception(e);
+		}
+	}
+
+private:
+	void start(unsigned threads) {
+		/* workers begin from the current generation so that a restarted pool
+		 * neither replays the last job nor misses one submitted before they run */
+		uint64_t seen;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = false;
+			seen = generation;
+		}
+		for (unsigned k = 1; k < threads; k += 1) {
+			workers.emplace_back([this, seen] { work(seen); });
+		}
+		worker_count = (unsigned) workers.size();
+	}
+
+	void stop(void) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers) { worker.join(); }
+		workers.clear();
+		worker_count = 0;
+	}
+
+	void drain(const std::function<void(uint64_t)>& task) {
+		inside_job() = true;
+		for (uint64_t k = next_task++; k < job_tasks; k = next_task++) {
+			try {
+				task(k);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!failure) { failure = std::current_exception(); }
+			}
+		}
+		inside_job() = false;
+	}
+
+	void work(uint64_t seen) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) { return; }
+			seen = generation;
+			const std::function<void(uint64_t)>* task = job;
+			lock.unlock();
+			drain(*task);
+			lock.lock();
+			if (--busy_workers == 0) { done.notify_all(); }
+		}
+	}
+};
+
+/*
+ * Expressions shorter than the parallel threshold (in elements) are always
+ * evaluated on the calling thread; the default keeps anything that fits in
+ * L2 cache serial, where handing work to other cores costs more than it saves.
+ */
+inline std::atomic<uint64_t>& parallel_threshold_storage(void) {
+	static std::atomic<uint64_t> threshold{1 << 16};
+	return threshold;
+}
+
+inline uint64_t parallel_threshold(void) { return parallel_threshold_storage(); }
+
+inline void set_parallel_threshold(uint64_t elements) { parallel_threshold_storage() = elements; }
+
+inline unsigned num_threads(void) { return thread_pool::global().concurrency(); }
+
+inline void set_num_threads(unsigned threads) { thread_pool::global().resize(threads == 0 ? 1 : threads); }
+
+/*
+ * Splits [begin, end) into disjoint chunks whose boundaries fall on multiples
+ * of grain (counted from begin) and calls body(chunk_begin, chunk_end) for each,
+ * in parallel. A few chunks per thread leave room for load balancing.
+ */
+template <typename Body>
+void parallel_for(uint64_t begin, uint64_t end, uint64_t grain, const Body& body) {
+	if (end <= begin) { return; }
+	thread_pool& pool = thread_pool::global();
+	uint64_t n = end - begin;
+	uint64_t chunks = 4 * (uint64_t) pool.concurrency();
+	uint64_t chunk = (n + chunks - 1) / chunks;
+	chunk = (chunk + grain - 1) / grain * grain;
+	uint64_t tasks = (n + chunk - 1) / chunk;
+
+	pool.run(tasks, [&](uint64_t k) {
+		uint64_t b = begin + k * chunk;
+		uint64_t e = end - b < chunk ? end : b + chunk;
+		body(b, e);
+	});
+}
+
+} //epl namespace
+
+#endif /* _ThreadPool_h */
@@ -1,30 +1,67 @@
 #ifndef _Valarray_h
 #define _Valarray_h
 #include "Vector.h"
+#include "Packet.h"
+#include "PacketMath.h"
+#include "ThreadPool.h"
+#include <cmath>
 #include <vector>
 #include <complex>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <utility>
 
 using epl::vector;
 
 template <typename V>
 struct VectorWrapper;
 
+template <typename T, typename Alloc = epl::default_allocator>
+using valarray = VectorWrapper<vector<T, Alloc>>;
+
+template <typename T, typename Alloc>
+class split_complex;
+
 template <typename T>
-using valarray = VectorWrapper<vector<T>>;
+class const_iterator;
+
+// a valarray of std::complex<T> stored as separate planes of real and
+// imaginary parts (see split_complex)
+template <typename T, typename Alloc = epl::default_allocator>
+using complex_valarray = VectorWrapper<split_complex<T, Alloc>>;
 
 template <typename T>
 struct choose_ref {
     using type = T;
 };
 
-template <typename T>
-struct choose_ref<vector<T>> {
-    using type = const vector<T>&;
+template <typename T, typename Alloc>
+struct choose_ref<vector<T, Alloc>> {
+    using type = const vector<T, Alloc>&;
+};
+
+template <typename T, typename Alloc>
+struct choose_ref<split_complex<T, Alloc>> {
+    using type = const split_complex<T, Alloc>&;
 };
 
 template <typename T>
 using ChooseRef = typename choose_ref<T>::type;
 
+// Owned<V> is the leaf an rvalue valarray becomes when it is used as an operand:
+// the expression takes over its buffer (moved, never copied), so an expression
+// built from a function's return value stays valid after that temporary is gone
+template <typename V>
+struct Owned : public V {
+    Owned(V&& that) : V(std::move(that)) {}
+
+    Owned(const Owned&) = default;
+
+    Owned(Owned&&) = default;
+};
+
 template <typename T>
 struct Rank {
     static constexpr int value = 0;
@@ -139,224 +176,2858 @@ struct root {
     result_type operator() (T x) const { return sqrt(x); }
 };
 
+namespace epl {
+template <typename T>
+struct packet_op<root<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_same<T, typename root<T>::result_type>::value;
+    using value_type = T;
+    static packet<T> apply(const root<T>&, const packet<T>& a) { return sqrt_lanes(a); }
+};
 
 template <typename T>
-class const_iterator {
-private:
-    const T parent; // might be better to use a pointer, but copying proxy is cheap
-    uint64_t index;
+struct operation_cost<root<T>> {
+    static constexpr uint64_t value = 8;
+};
 
-public:
-    const_iterator(const T _p, const uint64_t& _i) : parent(_p), index(_i) {}
+template <typename T>
+struct packet_op<root<std::complex<T>>> {
+    static constexpr bool value = packet_traits<std::complex<T>>::vectorizable && std::is_same<std::complex<T>, typename root<std::complex<T>>::result_type>::value;
+    using value_type = std::complex<T>;
+    static packet<value_type> apply(const root<value_type>&, const packet<value_type>& a) { return sqrt(a); }
+};
 
-    typename T::value_type operator*() const { return parent[index]; }
+template <typename T>
+struct operation_cost<root<std::complex<T>>> {
+    static constexpr uint64_t value = 28;
+};
+}
 
-    const_iterator& operator++() {
-        index++;
-        return *this;
-    }
+// a * b + c with one rounding, the product and c negated when ProductSign or
+// AddendSign is -1: the operation of the node operator+ and operator- make of
+// a product (see FmaProxy)
+template <typename T, int ProductSign = 1, int AddendSign = 1>
+struct multiply_add {
+    using result_type = T;
+    result_type operator() (T a, T b, T c) const { return std::fma(ProductSign < 0 ? -a : a, b, AddendSign < 0 ? -c : c); }
+};
 
-    const_iterator operator++(int) {
-        const_iterator t{*this};
-        this->operator++();
-        return t;
+namespace epl {
+template <typename T, int ProductSign, int AddendSign>
+struct packet_op<multiply_add<T, ProductSign, AddendSign>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+    using value_type = T;
+    static packet<T> apply(const multiply_add<T, ProductSign, AddendSign>&, const packet<T>& a, const packet<T>& b, const packet<T>& c) {
+        return fma_lanes(ProductSign < 0 ? -a : a, b, AddendSign < 0 ? -c : c);
     }
+};
+}
 
-    const_iterator& operator--() {
-        index--;
-        return *this;
+// +x, what -(-x) leaves of an array it reads by reference
+template <typename T>
+struct positive {
+    using result_type = T;
+    result_type operator() (T x) const { return x; }
+};
+
+namespace epl {
+template <typename T>
+struct packet_op<positive<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable;
+    using value_type = T;
+    static packet<T> apply(const positive<T>&, const packet<T>& a) { return a; }
+};
+
+template <typename T>
+struct operation_cost<positive<T>> {
+    static constexpr uint64_t value = 0;
+};
+}
+
+// x / d for a divisor fixed when the node is built, prepared from d once.
+// For int x, a multiplication by a magic number and shifts (Granlund and
+// Montgomery, "Division by invariant integers using multiplication"); the
+// quotient truncates toward zero as / does, and x / 0 is still x / 0.
+template <typename T, bool Floating = std::is_floating_point<T>::value>
+struct divided_by {
+    using result_type = T;
+
+    T d;
+    int32_t magic;  // m - 2^32 for the multiplier m of the paper, 2^31 < m <= 2^32 + 1
+    int shift;
+    uint32_t sign;  // all ones when d < 0
+
+    explicit divided_by(T divisor = 1) : d(divisor), magic(0), shift(0), sign(divisor < 0 ? ~0u : 0u) {
+        uint32_t a = divisor < 0 ? 0u - uint32_t(divisor) : uint32_t(divisor);
+        if (a == 0) { return; }
+        int l = 1;
+        while (l < 32 && (uint32_t(1) << l) < a) { ++l; }
+        uint64_t m = 1 + (uint64_t(1) << (31 + l)) / a;
+        magic = int32_t(int64_t(m) - (int64_t(1) << 32));
+        shift = l - 1;
     }
 
-    const_iterator operator--(int) {
-        const_iterator t{*this};
-        this->operator--();
-        return t;
+    // in unsigned arithmetic, where x + mulhi wraps for |d| = 1 and x = INT_MIN
+    result_type operator() (T x) const {
+        if (d == 0) { return x / d; }
+        uint32_t q = uint32_t(x) + uint32_t(int32_t(int64_t(x) * magic >> 32));
+        q = uint32_t(int32_t(q) >> shift) - uint32_t(x >> 31);
+        return T((q ^ sign) - sign);
     }
+};
 
-    bool operator==(const const_iterator& that) const {
-        return this->index == that.index;
+// For floating point x, x * (1 / d), which may differ from x / d in the last
+// bit (and overflow where x / d rounds to the largest finite value); a
+// divisor whose reciprocal is not finite and normal is divided by
+template <typename T>
+struct divided_by<T, true> {
+    using result_type = T;
+
+    T d;
+    T inverse;
+    bool reciprocal;
+
+    explicit divided_by(T divisor = 1) : d(divisor), inverse(T(1) / divisor), reciprocal(std::isnormal(inverse)) {}
+
+    result_type operator() (T x) const { return reciprocal ? x * inverse : x / d; }
+};
+
+namespace epl {
+template <typename T>
+struct packet_op<divided_by<T, false>> {
+    static constexpr bool value = packet_traits<T>::vectorizable;
+    using value_type = T;
+
+    static packet<T> apply(const divided_by<T, false>& op, const packet<T>& x) {
+        if (op.d == 0) { return x / op.d; }
+        typedef uint32_t unsigned_packet __attribute__((vector_size(sizeof(packet<T>))));
+        unsigned_packet q = (unsigned_packet) x + (unsigned_packet) mulhi_lanes(x, op.magic);
+        q = (unsigned_packet) ((packet<T>) q >> op.shift) - (unsigned_packet) (x >> 31);
+        return (packet<T>) ((q ^ op.sign) - op.sign);
     }
+};
 
-    bool operator!=(const const_iterator& that) const {
-        return !(*this == that);
+template <typename T>
+struct packet_op<divided_by<T, true>> {
+    static constexpr bool value = packet_traits<T>::vectorizable;
+    using value_type = T;
+
+    static packet<T> apply(const divided_by<T, true>& op, const packet<T>& x) {
+        return op.reciprocal ? x * broadcast_packet(op.inverse) : x / broadcast_packet(op.d);
     }
 };
 
+template <typename T, bool Floating>
+struct operation_cost<divided_by<T, Floating>> {
+    static constexpr uint64_t value = Floating ? 1 : 3;
+};
+}
 
+// |x|, which is real for complex x
 template <typename T>
-class Scalar {
-private:
-    T value;
+struct absolute {
+    using result_type = T;
+    result_type operator() (T x) const { return std::abs(x); }
+};
 
-public:
+template <typename T>
+struct absolute<std::complex<T>> {
+    using result_type = T;
+    result_type operator() (const std::complex<T>& x) const { return std::abs(x); }
+};
+
+namespace epl {
+template <typename T>
+struct packet_op<absolute<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable;
     using value_type = T;
+    static packet<T> apply(const absolute<T>&, const packet<T>& a) { return abs_lanes(a); }
+};
 
-    uint64_t size() const {
-        return std::numeric_limits<uint64_t>::max();
-    }
+template <typename T>
+struct packet_op<absolute<std::complex<T>>> {
+    static constexpr bool value = packet_traits<std::complex<T>>::vectorizable;
+    using value_type = std::complex<T>;
+    static packet<T> apply(const absolute<value_type>&, const packet<value_type>& a) { return abs(a); }
+};
 
-    T operator[] (uint64_t idx) const {
-        return value;
-    }
+template <typename T>
+struct operation_cost<absolute<std::complex<T>>> {
+    static constexpr uint64_t value = 12;
+};
+}
 
-    Scalar(const T& val): value(val) {}
+// The elementary functions of <cmath>, elementwise. Integers are computed in
+// double, as <cmath> does; float and double arrays use the packet kernels of
+// PacketMath.h where they pay off (see elementary_packets_enabled).
+template <typename T>
+using FloatingType = typename std::conditional<std::is_integral<T>::value, double, T>::type;
 
-    Scalar(const Scalar& that): value(that.value) {}
+template <typename T>
+struct exponential {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::exp(result_type(x)); }
+};
 
-    Scalar() = default;
+template <typename T>
+struct logarithm {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::log(result_type(x)); }
+};
 
-    ~Scalar() = default;
+template <typename T>
+struct sine {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::sin(result_type(x)); }
+};
 
-    const_iterator<Scalar> begin() const {
-        return const_iterator<Scalar>(*this, 0);
-    }
+template <typename T>
+struct cosine {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::cos(result_type(x)); }
+};
 
-    const_iterator<Scalar> end() const {
-        return const_iterator<Scalar>(*this, size());
-    }
+template <typename T>
+struct hyperbolic_tangent {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::tanh(result_type(x)); }
+};
 
+template <typename T>
+struct power {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x, T y) const { return std::pow(result_type(x), result_type(y)); }
 };
 
+template <typename T>
+struct round_down {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::floor(result_type(x)); }
+};
 
-template <typename T, typename Operator>
-class UnaryProxy {
-private:
-    ChooseRef<T> parent; // has-a relationship
-    Operator op;
+template <typename T>
+struct round_up {
+    using result_type = FloatingType<T>;
+    result_type operator() (T x) const { return std::ceil(result_type(x)); }
+};
 
-public:
-    using value_type = typename T::value_type;
+// NodeValue<Operator, T> is the value_type of a node applying Operator to
+// values of type T: T itself, except for the functions above, whose integer
+// operands make double expressions (exp(a) * 2 on an int array is not truncated)
+template <typename Operator>
+struct computes_in_floating_point : public std::false_type {};
+
+template <typename T> struct computes_in_floating_point<exponential<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<logarithm<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<sine<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<cosine<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<hyperbolic_tangent<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<power<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<round_down<T>> : public std::true_type {};
+template <typename T> struct computes_in_floating_point<round_up<T>> : public std::true_type {};
+
+template <typename Operator, typename T>
+using NodeValue = typename std::conditional<computes_in_floating_point<Operator>::value, FloatingType<T>, T>::type;
+
+namespace epl {
+// the polynomial kernels, for float and double lanes only
+template <typename T>
+struct elementary_packets {
+    static constexpr bool value = elementary_packets_enabled && packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+    using value_type = T;
+};
 
-    uint64_t size() const {
-        return parent.size();
-    }
+template <typename T>
+struct packet_op<exponential<T>> : public elementary_packets<T> {
+    static packet<T> apply(const exponential<T>&, const packet<T>& a) { return exp_lanes(a); }
+};
 
-    typename Operator::result_type operator[](uint64_t index) const {
-        return op(parent[index]);
-    }
+template <typename T>
+struct packet_op<logarithm<T>> : public elementary_packets<T> {
+    static packet<T> apply(const logarithm<T>&, const packet<T>& a) { return log_lanes(a); }
+};
 
-    UnaryProxy(ChooseRef<T> _p, Operator _op): parent(_p), op(_op) {}
+template <typename T>
+struct packet_op<sine<T>> : public elementary_packets<T> {
+    static packet<T> apply(const sine<T>&, const packet<T>& a) { return sin_lanes(a); }
+};
 
-    UnaryProxy(const UnaryProxy& that): parent(that.parent), op(that.op) {}
+template <typename T>
+struct packet_op<cosine<T>> : public elementary_packets<T> {
+    static packet<T> apply(const cosine<T>&, const packet<T>& a) { return cos_lanes(a); }
+};
 
-    UnaryProxy() = default;
+template <typename T>
+struct packet_op<hyperbolic_tangent<T>> : public elementary_packets<T> {
+    static packet<T> apply(const hyperbolic_tangent<T>&, const packet<T>& a) { return tanh_lanes(a); }
+};
 
-    ~UnaryProxy() = default;
+template <typename T>
+struct packet_op<power<T>> : public elementary_packets<T> {
+    static packet<T> apply(const power<T>&, const packet<T>& a, const packet<T>& b) { return pow_lanes(a, b); }
+};
 
-    const_iterator<UnaryProxy> begin() const {
-        return const_iterator<UnaryProxy>(*this, 0);
-    }
+// floor and ceil are exact either way
+template <typename T>
+struct packet_op<round_down<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+    using value_type = T;
+    static packet<T> apply(const round_down<T>&, const packet<T>& a) { return floor_lanes(a); }
+};
 
-    const_iterator<UnaryProxy> end() const {
-        return const_iterator<UnaryProxy>(*this, size());
-    }
+template <typename T>
+struct packet_op<round_up<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+    using value_type = T;
+    static packet<T> apply(const round_up<T>&, const packet<T>& a) { return ceil_lanes(a); }
 };
 
-template <typename Left, typename Right, typename Operator>
-class BinaryProxy {
-private:
-    ChooseRef<Left> l;
-    ChooseRef<Right> r;
-    Operator op;
+// a reduction, a polynomial of about a dozen terms and the reconstruction; pow is a log and an exp
+template <typename T>
+struct operation_cost<exponential<T>> {
+    static constexpr uint64_t value = 20;
+};
 
-public:
-    using value_type = typename ChooseType<typename Left::value_type, typename Right::value_type>::return_type;
+template <typename T>
+struct operation_cost<logarithm<T>> {
+    static constexpr uint64_t value = 24;
+};
 
-    typename Operator::result_type operator[](uint64_t idx) const {
-        return op(l[idx], r[idx]);
-    } // This is recursive
+template <typename T>
+struct operation_cost<sine<T>> {
+    static constexpr uint64_t value = 28;
+};
 
-    uint64_t size() const {
-        return l.size() < r.size() ? l.size() : r.size();
-    }
+template <typename T>
+struct operation_cost<cosine<T>> {
+    static constexpr uint64_t value = 28;
+};
 
-    BinaryProxy(ChooseRef<Left> _l, ChooseRef<Right> _r, Operator _op): l(_l), r(_r), op(_op) {}
+template <typename T>
+struct operation_cost<hyperbolic_tangent<T>> {
+    static constexpr uint64_t value = 40;
+};
 
-    BinaryProxy(const BinaryProxy& that) : l(that.l), r(that.r), op(that.op) {}
+template <typename T>
+struct operation_cost<power<T>> {
+    static constexpr uint64_t value = 48;
+};
 
-    BinaryProxy() = default;
+template <typename T>
+struct operation_cost<round_down<T>> {
+    static constexpr uint64_t value = 4;
+};
 
-    ~BinaryProxy() = default;
+template <typename T>
+struct operation_cost<round_up<T>> {
+    static constexpr uint64_t value = 4;
+};
+}
 
-    const_iterator<BinaryProxy> begin() const {
-        return const_iterator<BinaryProxy>(*this, 0);
-    }
+// Comparisons and logic, elementwise. Their elements are epl::boolean<T>,
+// which convert to bool (and to 1 or 0 when stored in an array of T); their
+// packets are the lane masks packet comparisons give, and && and || combine
+// masks bitwise, so nothing branches. The value_type of a comparison stays
+// that of its operands.
+template <typename T, typename Relation>
+struct comparison {
+    using result_type = epl::boolean<T>;
+    result_type operator() (T x, T y) const { return result_type(Relation{}(x, y)); }
+};
 
-    const_iterator<BinaryProxy> end() const {
-        return const_iterator<BinaryProxy>(*this, size());
-    }
+// Relation is std::bit_and<> or std::bit_or<>, for bools and masks alike
+template <typename T, typename Relation>
+struct logical {
+    using result_type = epl::boolean<T>;
+    result_type operator() (epl::boolean<T> x, epl::boolean<T> y) const { return result_type(Relation{}(x.value, y.value)); }
 };
 
+template <typename T>
+struct complement {
+    using result_type = epl::boolean<T>;
+    result_type operator() (epl::boolean<T> x) const { return result_type(!x.value); }
+};
 
-template <typename V>
-struct VectorWrapper : public V {
-    VectorWrapper() : V() {}
+// std::min and std::max: the first operand wins ties and unordered (NaN) pairs
+template <typename T>
+struct minimum {
+    using result_type = T;
+    result_type operator() (T x, T y) const { return std::min(x, y); }
+};
 
-    VectorWrapper(const V& that) : V(that) {}
+template <typename T>
+struct maximum {
+    using result_type = T;
+    result_type operator() (T x, T y) const { return std::max(x, y); }
+};
 
-    explicit VectorWrapper(uint64_t size) : V(size) {}
-    
+namespace epl {
+template <typename T, typename Relation>
+struct packet_op<comparison<T, Relation>> {
+    static constexpr bool value = packet_traits<boolean<T>>::vectorizable;
+    using value_type = T;
+    static packet<boolean<T>> apply(const comparison<T, Relation>&, const packet<T>& a, const packet<T>& b) { return Relation{}(a, b); }
+};
 
-    template <typename T>
-    VectorWrapper(const VectorWrapper<T>& that ) { // different types
-        for (auto val : that) {
-            this->push_back( static_cast<typename V::value_type>(val) );
-        }
-    }
+template <typename T, typename Relation>
+struct packet_op<logical<T, Relation>> {
+    static constexpr bool value = packet_traits<boolean<T>>::vectorizable;
+    using value_type = boolean<T>;
+    static packet<value_type> apply(const logical<T, Relation>&, const packet<value_type>& a, const packet<value_type>& b) { return Relation{}(a, b); }
+};
 
-    VectorWrapper& operator=(const VectorWrapper<V>& that) {  // left and right are the same type
-        if ((void*)this != (void*)&that) {
-            uint64_t min_size = this->size() < that.size() ? this->size() : that.size();
-            for (uint64_t i = 0; i < min_size; ++i) {
-                (*this)[i] = that[i];
-            }
-        }
-        return *this;
-    }
+template <typename T>
+struct packet_op<complement<T>> {
+    static constexpr bool value = packet_traits<boolean<T>>::vectorizable;
+    using value_type = boolean<T>;
+    static packet<value_type> apply(const complement<T>&, const packet<value_type>& a) { return ~a; }
+};
 
-    template <typename T>
-    EnableIf<Rank<T>::value, VectorWrapper&> operator=(const T& that) {
-        this->operator=(VectorWrapper<Scalar<T>>(that));
-    }
+template <typename T>
+struct packet_op<minimum<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_arithmetic<T>::value;
+    using value_type = T;
+    static packet<T> apply(const minimum<T>&, const packet<T>& a, const packet<T>& b) { return b < a ? b : a; }
+};
 
-    template <typename T>
-    VectorWrapper& operator=(const VectorWrapper<T>& that) {    // left and right are different types
-        if ((void*)this != (void*)&that) {
-            uint64_t min_size = this->size() < that.size() ? this->size() : that.size();
-            for (uint64_t i = 0; i < min_size; ++i) {
-                (*this)[i] = static_cast<typename V::value_type>(that[i]);
-            }
-        }
-        return *this;
-    }
+template <typename T>
+struct packet_op<maximum<T>> {
+    static constexpr bool value = packet_traits<T>::vectorizable && std::is_arithmetic<T>::value;
+    using value_type = T;
+    static packet<T> apply(const maximum<T>&, const packet<T>& a, const packet<T>& b) { return a < b ? b : a; }
+};
+}
 
-    template <typename Operator>
-    VectorWrapper<UnaryProxy<V, Operator>> apply(Operator op) {
-        return VectorWrapper<UnaryProxy<V, Operator>>( UnaryProxy<V, Operator>(*this, op) );
-    }
+// the positions [begin, end) of a node at which packet() may be used
+struct IndexRange {
+    uint64_t begin;
+    uint64_t end;
 
+    static IndexRange all() { return IndexRange{0, std::numeric_limits<uint64_t>::max()}; }
 
-    VectorWrapper<UnaryProxy<V, root<typename V::value_type>>> sqrt(void) {
-        return apply(root<typename V::value_type>{});
+    IndexRange operator&(const IndexRange& that) const {
+        uint64_t b = std::max(begin, that.begin);
+        return IndexRange{b, std::max(b, std::min(end, that.end))};
     }
+};
 
-    VectorWrapper<UnaryProxy<V, std::negate<typename V::value_type>>> operator-(void) {
-        return apply(std::negate<typename V::value_type>{});
-    }
+// Access is how the evaluator reads a node of the expression tree: element() is
+// an unchecked scalar read, packet() reads packet_traits<element_type>::size
+// consecutive elements and is only available when vectorizable is true.
+// packet() may also assume that all of them lie in interior(), the range where
+// nodes such as shifts need no boundary handling; element() is valid anywhere.
+// aliases() tells whether the node reads memory in [lo, hi) at a position
+// other than the one being evaluated (when shifted is true, any read counts),
+// which makes that memory unsafe to overwrite while evaluating.
+// Proxies describe themselves through members, leaves specialize Access.
+template <typename T>
+struct Access {
+    using element_type = typename T::element_type;
+    static constexpr bool vectorizable = T::vectorizable;
 
-    template <typename T>
-    VectorWrapper(std::initializer_list<T> il) : V(il) {}
+    static element_type element(const T& x, uint64_t idx) { return x.element(idx); }
+
+    static epl::packet<element_type> packet(const T& x, uint64_t idx) { return x.packet(idx); }
+
+    static IndexRange interior(const T& x) { return x.interior(); }
+
+    static bool aliases(const T& x, const void* lo, const void* hi, bool shifted) { return x.aliases(lo, hi, shifted); }
+};
+
+// true when a leaf's elements [p, p + n) overlap the bytes [lo, hi)
+template <typename T>
+bool overlaps(const T* p, uint64_t n, const void* lo, const void* hi) {
+    return n > 0 && (const void*) p < hi && (const void*) (p + n) > lo;
+}
+
+template <typename T, typename Alloc>
+struct Access<vector<T, Alloc>> {
+    using element_type = T;
+    static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable;
+
+    static element_type element(const vector<T, Alloc>& x, uint64_t idx) { return x.data()[idx]; }
+
+    static epl::packet<element_type> packet(const vector<T, Alloc>& x, uint64_t idx) { return epl::load_packet(x.data() + idx); }
+
+    static IndexRange interior(const vector<T, Alloc>&) { return IndexRange::all(); }
+
+    static bool aliases(const vector<T, Alloc>& x, const void* lo, const void* hi, bool shifted) {
+        return shifted && overlaps(x.data(), x.size(), lo, hi);
+    }
+};
+
+template <typename V>
+struct Access<Owned<V>> : public Access<V> {};
+
+// Span is a non-owning, writable window onto a vector's elements: the leaf a
+// view of a modifiable valarray refers to. Like any reference into a vector it
+// is invalidated when the vector reallocates.
+template <typename T>
+struct Span {
+    using value_type = T;
+
+    T* base;
+    uint64_t length;
+
+    uint64_t size() const { return length; }
+
+    T& operator[](uint64_t idx) const { return base[idx]; }
+};
+
+template <typename T>
+struct Access<Span<T>> {
+    using element_type = T;
+    static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable;
+
+    static element_type element(const Span<T>& x, uint64_t idx) { return x.base[idx]; }
+
+    static epl::packet<element_type> packet(const Span<T>& x, uint64_t idx) { return epl::load_packet(x.base + idx); }
+
+    static IndexRange interior(const Span<T>&) { return IndexRange::all(); }
+
+    static bool aliases(const Span<T>& x, const void* lo, const void* hi, bool shifted) {
+        return shifted && overlaps(x.base, x.length, lo, hi);
+    }
+};
+
+// SplitSpan is the Span of split complex storage: a writable window onto
+// length elements whose parts lie in two planes
+template <typename T>
+struct SplitSpan {
+    using value_type = std::complex<T>;
+
+    T* re;
+    T* im;
+    uint64_t length;
+
+    uint64_t size() const { return length; }
+};
+
+template <typename T>
+struct Access<SplitSpan<T>> {
+    using element_type = std::complex<T>;
+    static constexpr bool vectorizable = epl::packet_traits<element_type>::vectorizable;
+
+    static element_type element(const SplitSpan<T>& x, uint64_t idx) { return element_type(x.re[idx], x.im[idx]); }
+
+    static epl::packet<element_type> packet(const SplitSpan<T>& x, uint64_t idx) {
+        return epl::packet<element_type>{epl::load_packet(x.re + idx), epl::load_packet(x.im + idx)};
+    }
+
+    static IndexRange interior(const SplitSpan<T>&) { return IndexRange::all(); }
+
+    static bool aliases(const SplitSpan<T>& x, const void* lo, const void* hi, bool shifted) {
+        return shifted && (overlaps(x.re, x.length, lo, hi) || overlaps(x.im, x.length, lo, hi));
+    }
+};
+
+// split_complex holds n complex numbers as a plane of n real parts followed by
+// a plane of n imaginary parts, in one buffer. Complex packets load and store
+// each plane directly, where arrays of std::complex have to be deinterleaved,
+// and the planes can be handed as they are to code that takes split data
+// (FFTs, BLAS-style kernels). Reading an element gives a std::complex<T>;
+// writing one goes through a reference that sets both parts.
+template <typename T, typename Alloc = epl::default_allocator>
+class split_complex {
+private:
+    vector<T, Alloc> planes;
+    T* imag; // planes.data() + size(), kept so that reading a plane is a single load
+
+public:
+    using value_type = std::complex<T>;
+    using element_type = std::complex<T>;
+
+    class reference {
+    private:
+        T* re;
+        T* im;
+
+    public:
+        reference(T* _re, T* _im) : re(_re), im(_im) {}
+
+        operator std::complex<T>() const { return std::complex<T>(*re, *im); }
+
+        reference& operator=(const std::complex<T>& value) {
+            *re = value.real();
+            *im = value.imag();
+            return *this;
+        }
+
+        reference& operator=(const reference& that) { return *this = std::complex<T>(that); }
+
+        T real() const { return *re; }
+        T imag() const { return *im; }
+
+        friend bool operator==(const reference& x, const std::complex<T>& y) { return std::complex<T>(x) == y; }
+        friend bool operator==(const std::complex<T>& x, const reference& y) { return x == std::complex<T>(y); }
+        friend bool operator!=(const reference& x, const std::complex<T>& y) { return !(x == y); }
+        friend bool operator!=(const std::complex<T>& x, const reference& y) { return !(x == y); }
+    };
+
+    split_complex() : imag(planes.data()) {}
+
+    explicit split_complex(uint64_t size) : planes(2 * size), imag(planes.data() + size) {}
+
+    split_complex(uint64_t size, epl::uninitialized_t) : planes(2 * size, epl::uninitialized), imag(planes.data() + size) {}
+
+    template <typename U>
+    split_complex(std::initializer_list<U> il) : planes(2 * il.size(), epl::uninitialized), imag(planes.data() + il.size()) {
+        uint64_t idx = 0;
+        for (const U& x : il) {
+            (*this)[idx++] = std::complex<T>(x);
+        }
+    }
+
+    split_complex(const split_complex& that) : planes(that.planes), imag(planes.data() + that.size()) {}
+
+    split_complex(split_complex&& that) : planes(std::move(that.planes)), imag(that.imag) {
+        that.imag = that.planes.data();
+    }
+
+    split_complex& operator=(const split_complex& that) {
+        planes = that.planes;
+        imag = planes.data() + that.size();
+        return *this;
+    }
+
+    split_complex& operator=(split_complex&& that) {
+        if (this != &that) {
+            planes = std::move(that.planes);
+            imag = that.imag;
+            that.imag = that.planes.data();
+        }
+        return *this;
+    }
+
+    uint64_t size() const { return planes.size() / 2; }
+
+    T* real_data() { return planes.data(); }
+    const T* real_data() const { return planes.data(); }
+    T* imag_data() { return imag; }
+    const T* imag_data() const { return imag; }
+
+    std::complex<T> operator[](uint64_t idx) const {
+        if (idx >= size()) { throw std::out_of_range("subscript out of range"); }
+        return std::complex<T>(real_data()[idx], imag_data()[idx]);
+    }
+
+    reference operator[](uint64_t idx) {
+        if (idx >= size()) { throw std::out_of_range("subscript out of range"); }
+        return reference(real_data() + idx, imag_data() + idx);
+    }
+
+    SplitSpan<T> span() { return SplitSpan<T>{real_data(), imag_data(), size()}; }
+
+    const_iterator<split_complex> begin() const {
+        return const_iterator<split_complex>(*this, 0);
+    }
+
+    const_iterator<split_complex> end() const {
+        return const_iterator<split_complex>(*this, size());
+    }
+};
+
+template <typename T, typename Alloc>
+struct Access<split_complex<T, Alloc>> {
+    using element_type = std::complex<T>;
+    static constexpr bool vectorizable = epl::packet_traits<element_type>::vectorizable;
+
+    static element_type element(const split_complex<T, Alloc>& x, uint64_t idx) {
+        return element_type(x.real_data()[idx], x.imag_data()[idx]);
+    }
+
+    static epl::packet<element_type> packet(const split_complex<T, Alloc>& x, uint64_t idx) {
+        return epl::packet<element_type>{epl::load_packet(x.real_data() + idx), epl::load_packet(x.imag_data() + idx)};
+    }
+
+    static IndexRange interior(const split_complex<T, Alloc>&) { return IndexRange::all(); }
+
+    static bool aliases(const split_complex<T, Alloc>& x, const void* lo, const void* hi, bool shifted) {
+        return shifted && overlaps(x.real_data(), 2 * x.size(), lo, hi);
+    }
+};
+
+// Store is how the evaluator writes the destination of an assignment.
+// destination() turns the node being assigned to into a cheap handle (a
+// pointer for vectors, a copy for views) that element() and packet() write
+// through; owner is true when the node holds its own buffer, and owners
+// report the bytes it spans through extent(). independent()
+// is false when two indices may write the same element, which rules out
+// packets and threads. Views describe themselves through store(),
+// store_packet() and independent() members.
+template <typename V>
+struct Store {
+    using element_type = typename V::element_type;
+    static constexpr bool owner = false;
+
+    static V destination(const V& x) { return x; }
+
+    static bool independent(const V& x) { return x.independent(); }
+
+    static void element(const V& x, uint64_t idx, const element_type& value) { x.store(idx, value); }
+
+    static void packet(const V& x, uint64_t idx, const epl::packet<element_type>& value) { x.store_packet(idx, value); }
+};
+
+template <typename T>
+struct Store<T*> {
+    using element_type = T;
+    static constexpr bool owner = false;
+
+    static bool independent(T*) { return true; }
+
+    static void element(T* x, uint64_t idx, const T& value) { x[idx] = value; }
+
+    static void packet(T* x, uint64_t idx, const epl::packet<T>& value) { epl::store_packet(x + idx, value); }
+};
+
+template <typename T>
+struct Store<Span<T>> {
+    using element_type = T;
+    static constexpr bool owner = false;
+
+    static Span<T> destination(const Span<T>& x) { return x; }
+
+    static bool independent(const Span<T>&) { return true; }
+
+    static void element(const Span<T>& x, uint64_t idx, const T& value) { x.base[idx] = value; }
+
+    static void packet(const Span<T>& x, uint64_t idx, const epl::packet<T>& value) { epl::store_packet(x.base + idx, value); }
+};
+
+template <typename T, typename Alloc>
+struct Store<vector<T, Alloc>> : public Store<T*> {
+    static constexpr bool owner = true;
+
+    static T* destination(vector<T, Alloc>& x) { return x.data(); }
+
+    static std::pair<const void*, const void*> extent(const vector<T, Alloc>& x) { return {x.data(), x.data() + x.size()}; }
+};
+
+template <typename T>
+struct Store<SplitSpan<T>> {
+    using element_type = std::complex<T>;
+    static constexpr bool owner = false;
+
+    static SplitSpan<T> destination(const SplitSpan<T>& x) { return x; }
+
+    static bool independent(const SplitSpan<T>&) { return true; }
+
+    static void element(const SplitSpan<T>& x, uint64_t idx, const element_type& value) {
+        x.re[idx] = value.real();
+        x.im[idx] = value.imag();
+    }
+
+    static void packet(const SplitSpan<T>& x, uint64_t idx, const epl::packet<element_type>& value) {
+        epl::store_packet(x.re + idx, value.re);
+        epl::store_packet(x.im + idx, value.im);
+    }
+};
+
+template <typename T, typename Alloc>
+struct Store<split_complex<T, Alloc>> : public Store<SplitSpan<T>> {
+    static constexpr bool owner = true;
+
+    static SplitSpan<T> destination(split_complex<T, Alloc>& x) { return x.span(); }
+
+    static std::pair<const void*, const void*> extent(const split_complex<T, Alloc>& x) {
+        return {x.real_data(), x.real_data() + 2 * x.size()};
+    }
+};
+
+// true when Operator maps packets of the children's element type onto packets of the same type
+template <typename Operator, typename... Children>
+struct PacketOperands {
+    static constexpr bool value = false;
+};
+
+template <typename Operator, typename Child>
+struct PacketOperands<Operator, Child> {
+    static constexpr bool value = epl::packet_op<Operator>::value
+        && Access<Child>::vectorizable
+        && std::is_same<typename Access<Child>::element_type, typename epl::packet_op<Operator>::value_type>::value;
+};
+
+template <typename Operator, typename Child, typename... Rest>
+struct PacketOperands<Operator, Child, Rest...> {
+    static constexpr bool value = PacketOperands<Operator, Child>::value && PacketOperands<Operator, Rest...>::value;
+};
+
+
+// const_iterator walks a proxy by index, computing elements on demand, so
+// lazy expressions can be handed to standard algorithms without being
+// materialized. It is tagged random access, which is what the std::execution
+// algorithms check before splitting a range across threads, although *it is a
+// value, not a reference (std::vector<bool>::iterator makes the same choice).
+// It refers to the proxy, which must outlive it: auto it = (a + b).begin(); dangles.
+template <typename T>
+class const_iterator {
+private:
+    const T* parent;
+    uint64_t index;
+
+public:
+    using iterator_category = std::random_access_iterator_tag;
+#if __cplusplus > 201703L
+    using iterator_concept = std::random_access_iterator_tag;
+#endif
+    using value_type = typename T::value_type;
+    using difference_type = int64_t;
+    using pointer = const value_type*;
+    using reference = value_type;
+
+    const_iterator() : parent(nullptr), index(0) {}
+
+    const_iterator(const T& _p, uint64_t _i) : parent(&_p), index(_i) {}
+
+    value_type operator*() const { return static_cast<value_type>(Access<T>::element(*parent, index)); }
+
+    value_type operator[](difference_type k) const { return static_cast<value_type>(Access<T>::element(*parent, index + k)); }
+
+    const_iterator& operator++() {
+        index++;
+        return *this;
+    }
+
+    const_iterator operator++(int) {
+        const_iterator t{*this};
+        this->operator++();
+        return t;
+    }
+
+    const_iterator& operator--() {
+        index--;
+        return *this;
+    }
+
+    const_iterator operator--(int) {
+        const_iterator t{*this};
+        this->operator--();
+        return t;
+    }
+
+    const_iterator& operator+=(difference_type k) {
+        index += k;
+        return *this;
+    }
+
+    const_iterator& operator-=(difference_type k) {
+        index -= k;
+        return *this;
+    }
+
+    const_iterator operator+(difference_type k) const { return const_iterator{*this} += k; }
+
+    const_iterator operator-(difference_type k) const { return const_iterator{*this} -= k; }
+
+    friend const_iterator operator+(difference_type k, const const_iterator& it) { return it + k; }
+
+    difference_type operator-(const const_iterator& that) const { return (difference_type) (this->index - that.index); }
+
+    bool operator==(const const_iterator& that) const {
+        return this->index == that.index;
+    }
+
+    bool operator!=(const const_iterator& that) const {
+        return !(*this == that);
+    }
+
+    bool operator<(const const_iterator& that) const { return this->index < that.index; }
+    bool operator>(const const_iterator& that) const { return that < *this; }
+    bool operator<=(const const_iterator& that) const { return !(that < *this); }
+    bool operator>=(const const_iterator& that) const { return !(*this < that); }
+};
+
+
+template <typename T>
+class Scalar {
+private:
+    T value;
+
+public:
+    using value_type = T;
+    using element_type = T;
+    static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable;
+
+    uint64_t size() const {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    T operator[] (uint64_t idx) const {
+        return value;
+    }
+
+    T element(uint64_t) const {
+        return value;
+    }
+
+    epl::packet<T> packet(uint64_t) const {
+        return epl::broadcast_packet(value);
+    }
+
+    IndexRange interior() const {
+        return IndexRange::all();
+    }
+
+    bool aliases(const void*, const void*, bool) const {
+        return false;
+    }
+
+    Scalar(const T& val): value(val) {}
+
+    Scalar(const Scalar& that): value(that.value) {}
+
+    Scalar() = default;
+
+    ~Scalar() = default;
+
+    const_iterator<Scalar> begin() const {
+        return const_iterator<Scalar>(*this, 0);
+    }
+
+    const_iterator<Scalar> end() const {
+        return const_iterator<Scalar>(*this, size());
+    }
+
+};
+
+
+template <typename T, typename Operator>
+class UnaryProxy {
+private:
+    ChooseRef<T> parent; // has-a relationship
+    Operator op;
+
+    template <typename, typename>
+    friend struct negation;
+
+    template <typename, typename>
+    friend struct negated_node;
+
+public:
+    using value_type = NodeValue<Operator, typename T::value_type>;
+    using element_type = typename Operator::result_type;
+    static constexpr bool vectorizable = PacketOperands<Operator, T>::value;
+
+    uint64_t size() const {
+        return parent.size();
+    }
+
+    typename Operator::result_type operator[](uint64_t index) const {
+        return op(parent[index]);
+    }
+
+    element_type element(uint64_t index) const {
+        return op(Access<T>::element(parent, index));
+    }
+
+    epl::packet<element_type> packet(uint64_t index) const {
+        return epl::packet_op<Operator>::apply(op, Access<T>::packet(parent, index));
+    }
+
+    IndexRange interior() const {
+        return Access<T>::interior(parent);
+    }
+
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        return Access<T>::aliases(parent, lo, hi, shifted);
+    }
+
+    UnaryProxy(ChooseRef<T> _p, Operator _op): parent(std::move(_p)), op(_op) {}
+
+    UnaryProxy(const UnaryProxy& that) = default;
+
+    UnaryProxy(UnaryProxy&& that) = default;
+
+    UnaryProxy() = default;
+
+    ~UnaryProxy() = default;
+
+    const_iterator<UnaryProxy> begin() const {
+        return const_iterator<UnaryProxy>(*this, 0);
+    }
+
+    const_iterator<UnaryProxy> end() const {
+        return const_iterator<UnaryProxy>(*this, size());
+    }
+};
+
+template <typename Left, typename Right, typename Operator>
+class BinaryProxy {
+private:
+    ChooseRef<Left> l;
+    ChooseRef<Right> r;
+    Operator op;
+
+    template <typename, typename, typename, typename>
+    friend class FmaProxy;
+
+    template <typename, typename>
+    friend struct scalar_node;
+
+public:
+    using left_type = Left;
+    using right_type = Right;
+    using value_type = NodeValue<Operator, typename ChooseType<typename Left::value_type, typename Right::value_type>::return_type>;
+    using element_type = typename Operator::result_type;
+    static constexpr bool vectorizable = PacketOperands<Operator, Left, Right>::value;
+
+    typename Operator::result_type operator[](uint64_t idx) const {
+        return op(l[idx], r[idx]);
+    } // This is recursive
+
+    element_type element(uint64_t idx) const {
+        return op(Access<Left>::element(l, idx), Access<Right>::element(r, idx));
+    }
+
+    epl::packet<element_type> packet(uint64_t idx) const {
+        return epl::packet_op<Operator>::apply(op, Access<Left>::packet(l, idx), Access<Right>::packet(r, idx));
+    }
+
+    IndexRange interior() const {
+        return Access<Left>::interior(l) & Access<Right>::interior(r);
+    }
+
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        return Access<Left>::aliases(l, lo, hi, shifted) || Access<Right>::aliases(r, lo, hi, shifted);
+    }
+
+    uint64_t size() const {
+        return l.size() < r.size() ? l.size() : r.size();
+    }
+
+    BinaryProxy(ChooseRef<Left> _l, ChooseRef<Right> _r, Operator _op): l(std::move(_l)), r(std::move(_r)), op(_op) {}
+
+    BinaryProxy(const BinaryProxy& that) = default;
+
+    BinaryProxy(BinaryProxy&& that) = default;
+
+    BinaryProxy() = default;
+
+    ~BinaryProxy() = default;
+
+    const_iterator<BinaryProxy> begin() const {
+        return const_iterator<BinaryProxy>(*this, 0);
+    }
+
+    const_iterator<BinaryProxy> end() const {
+        return const_iterator<BinaryProxy>(*this, size());
+    }
+};
+
+// FmaProxy computes l * r + c with a single rounding (signs as Operator, a
+// multiply_add, says). operator+ and operator- build it from a product made
+// in the same expression, a BinaryProxy it takes apart, when the target has
+// fused multiply-add (EPL_FMA): one instruction per packet instead of two,
+// and a result closer to exact.
+template <typename Left, typename Right, typename Addend, typename Operator>
+class FmaProxy {
+private:
+    ChooseRef<Left> l;
+    ChooseRef<Right> r;
+    ChooseRef<Addend> c;
+
+public:
+    using value_type = typename ChooseType<typename ChooseType<typename Left::value_type, typename Right::value_type>::return_type, typename Addend::value_type>::return_type;
+    using element_type = typename Operator::result_type;
+    static constexpr bool vectorizable = PacketOperands<Operator, Left, Right, Addend>::value;
+
+    element_type operator[](uint64_t idx) const {
+        return element(idx);
+    }
+
+    element_type element(uint64_t idx) const {
+        return Operator{}(Access<Left>::element(l, idx), Access<Right>::element(r, idx), Access<Addend>::element(c, idx));
+    }
+
+    epl::packet<element_type> packet(uint64_t idx) const {
+        return epl::packet_op<Operator>::apply(Operator{}, Access<Left>::packet(l, idx), Access<Right>::packet(r, idx), Access<Addend>::packet(c, idx));
+    }
+
+    IndexRange interior() const {
+        return Access<Left>::interior(l) & Access<Right>::interior(r) & Access<Addend>::interior(c);
+    }
+
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        return Access<Left>::aliases(l, lo, hi, shifted) || Access<Right>::aliases(r, lo, hi, shifted) || Access<Addend>::aliases(c, lo, hi, shifted);
+    }
+
+    uint64_t size() const {
+        return std::min(std::min(l.size(), r.size()), c.size());
+    }
+
+    template <typename Product>
+    FmaProxy(BinaryProxy<Left, Right, Product>&& product, ChooseRef<Addend> _c): l(std::move(product.l)), r(std::move(product.r)), c(std::move(_c)) {}
+
+    FmaProxy(const FmaProxy& that) = default;
+
+    FmaProxy(FmaProxy&& that) = default;
+
+    ~FmaProxy() = default;
+
+    const_iterator<FmaProxy> begin() const {
+        return const_iterator<FmaProxy>(*this, 0);
+    }
+
+    const_iterator<FmaProxy> end() const {
+        return const_iterator<FmaProxy>(*this, size());
+    }
+};
+
+// where(m, a, b)[i] is a[i] where m[i] holds and b[i] elsewhere. Both sides
+// are computed and blended, so a mask as wide as the result (a comparison of
+// values of the same size) picks lanes without branching; any other m is
+// tested element by element, nonzero meaning true.
+template <typename Mask, typename Left, typename Right>
+class WhereProxy {
+private:
+    ChooseRef<Mask> m;
+    ChooseRef<Left> l;
+    ChooseRef<Right> r;
+
+    using MaskElement = typename Access<Mask>::element_type;
+
+public:
+    using value_type = typename ChooseType<typename Left::value_type, typename Right::value_type>::return_type;
+    using element_type = value_type;
+    static constexpr bool vectorizable = Access<Mask>::vectorizable && Access<Left>::vectorizable && Access<Right>::vectorizable
+        && epl::is_boolean<MaskElement>::value && epl::boolean_packet<element_type>::vectorizable
+        && std::is_same<epl::packet<MaskElement>, typename epl::boolean_packet<element_type>::type>::value
+        && std::is_same<typename Access<Left>::element_type, element_type>::value
+        && std::is_same<typename Access<Right>::element_type, element_type>::value;
+
+    element_type operator[](uint64_t idx) const {
+        return element(idx);
+    }
+
+    element_type element(uint64_t idx) const {
+        return epl::truth(Access<Mask>::element(m, idx)) ? element_type(Access<Left>::element(l, idx)) : element_type(Access<Right>::element(r, idx));
+    }
+
+    epl::packet<element_type> packet(uint64_t idx) const {
+        return Access<Mask>::packet(m, idx) ? Access<Left>::packet(l, idx) : Access<Right>::packet(r, idx);
+    }
+
+    IndexRange interior() const {
+        return Access<Mask>::interior(m) & Access<Left>::interior(l) & Access<Right>::interior(r);
+    }
+
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        return Access<Mask>::aliases(m, lo, hi, shifted) || Access<Left>::aliases(l, lo, hi, shifted) || Access<Right>::aliases(r, lo, hi, shifted);
+    }
+
+    uint64_t size() const {
+        return std::min(m.size(), std::min(l.size(), r.size()));
+    }
+
+    WhereProxy(ChooseRef<Mask> _m, ChooseRef<Left> _l, ChooseRef<Right> _r): m(std::move(_m)), l(std::move(_l)), r(std::move(_r)) {}
+
+    WhereProxy(const WhereProxy& that) = default;
+
+    WhereProxy(WhereProxy&& that) = default;
+
+    ~WhereProxy() = default;
+
+    const_iterator<WhereProxy> begin() const {
+        return const_iterator<WhereProxy>(*this, 0);
+    }
+
+    const_iterator<WhereProxy> end() const {
+        return const_iterator<WhereProxy>(*this, size());
+    }
+};
+
+
+// A selector picks which elements of a node a view shows. It provides
+//     size()        the number of elements selected
+//     index(i)      the position in the node of the i-th of them
+//     bound()       one past the largest position (0 when nothing is selected)
+//     contiguous()  true when index(i) == index(0) + i throughout, which keeps
+//                   whole-packet loads and stores on views
+//     repeats()     true when a position may be picked more than once; such
+//                   views are assigned serially, one element at a time
+//     lookahead     how many elements ahead to prefetch (0 when the hardware
+//                   prefetcher can follow the access pattern on its own)
+//     index_bytes   memory read per element to find its position
+struct slice {
+    slice(uint64_t start, uint64_t size, uint64_t stride) : first(start), length(size), step(stride) {}
+
+    uint64_t start() const { return first; }
+    uint64_t size() const { return length; }
+    uint64_t stride() const { return step; }
+
+    uint64_t index(uint64_t i) const { return first + i * step; }
+    uint64_t bound() const { return length == 0 ? 0 : index(length - 1) + 1; }
+    bool contiguous() const { return step == 1 || length <= 1; }
+    bool repeats() const { return step == 0 && length > 1; }
+
+    static constexpr uint64_t lookahead = 0;
+    static constexpr uint64_t index_bytes = 0;
+
+private:
+    uint64_t first;
+    uint64_t length;
+    uint64_t step;
+};
+
+// gslice selects start + sum(k[d] * strides[d]) for 0 <= k[d] < lengths[d],
+// the last dimension varying fastest (as std::gslice). The positions are
+// computed once and shared between copies of the selector.
+struct gslice {
+    gslice(uint64_t start, const std::vector<uint64_t>& lengths, const std::vector<uint64_t>& strides) {
+        if (lengths.size() != strides.size()) { throw std::invalid_argument("gslice lengths and strides differ in rank"); }
+        auto table = std::make_shared<std::vector<uint64_t>>();
+        uint64_t count = lengths.empty() ? 0 : 1;
+        for (uint64_t n : lengths) { count *= n; }
+        table->reserve(count);
+
+        std::vector<uint64_t> k(lengths.size(), 0);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t pos = start;
+            for (uint64_t d = 0; d < k.size(); ++d) { pos += k[d] * strides[d]; }
+            table->push_back(pos);
+            for (uint64_t d = k.size(); d-- > 0; ) {
+                if (++k[d] < lengths[d]) { break; }
+                k[d] = 0;
+            }
+        }
+
+        dense = true;
+        largest = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            dense = dense && (*table)[i] == (*table)[0] + i;
+            largest = std::max(largest, (*table)[i] + 1);
+        }
+        std::vector<uint64_t> sorted(*table);
+        std::sort(sorted.begin(), sorted.end());
+        repeated = std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end();
+        positions = std::move(table);
+    }
+
+    uint64_t size() const { return positions->size(); }
+
+    uint64_t index(uint64_t i) const { return (*positions)[i]; }
+    uint64_t bound() const { return largest; }
+    bool contiguous() const { return dense; }
+    bool repeats() const { return repeated; }
+
+    static constexpr uint64_t lookahead = 0;
+    static constexpr uint64_t index_bytes = sizeof(uint64_t);
+
+private:
+    std::shared_ptr<const std::vector<uint64_t>> positions;
+    uint64_t largest;
+    bool dense;
+    bool repeated;
+};
+
+// indirect_selector picks the positions held in an index array, which it reads
+// in place (see indirect()): the index array must outlive the view. Positions
+// come in arbitrary order, so they are prefetched ahead of use. Indices that
+// are not strictly increasing may repeat, and such views are assigned serially
+// in index order: with a[indirect(bins)] += 1 every occurrence of a bin counts.
+template <typename I>
+struct indirect_selector {
+    indirect_selector(const I* _p, uint64_t _n) : positions(_p), length(_n), largest(0), increasing(true) {
+        for (uint64_t i = 0; i < length; ++i) {
+            if (positions[i] < I(0)) { throw std::out_of_range("negative index"); }
+            uint64_t pos = (uint64_t) positions[i];
+            increasing = increasing && (i == 0 || pos > (uint64_t) positions[i - 1]);
+            largest = std::max(largest, pos + 1);
+        }
+    }
+
+    uint64_t size() const { return length; }
+
+    uint64_t index(uint64_t i) const { return (uint64_t) positions[i]; }
+    uint64_t bound() const { return largest; }
+    bool contiguous() const { return length <= 1; }
+    bool repeats() const { return !increasing; }
+
+    static constexpr uint64_t lookahead = 32;
+    static constexpr uint64_t index_bytes = sizeof(I);
+
+private:
+    const I* positions;
+    uint64_t length;
+    uint64_t largest;
+    bool increasing;
+};
+
+// mask_selector picks the positions where a mask is nonzero (see mask()),
+// found once and shared between copies of the selector
+struct mask_selector {
+    explicit mask_selector(std::vector<uint64_t> picked) {
+        dense = picked.empty() || picked.back() - picked.front() + 1 == picked.size();
+        positions = std::make_shared<const std::vector<uint64_t>>(std::move(picked));
+    }
+
+    uint64_t size() const { return positions->size(); }
+
+    uint64_t index(uint64_t i) const { return (*positions)[i]; }
+    uint64_t bound() const { return positions->empty() ? 0 : positions->back() + 1; }
+    bool contiguous() const { return dense; }
+    bool repeats() const { return false; }
+
+    static constexpr uint64_t lookahead = 0;
+    static constexpr uint64_t index_bytes = sizeof(uint64_t);
+
+private:
+    std::shared_ptr<const std::vector<uint64_t>> positions;
+    bool dense;
+};
+
+template <typename T>
+struct is_selector : public std::false_type {};
+
+template <>
+struct is_selector<slice> : public std::true_type {};
+
+template <>
+struct is_selector<gslice> : public std::true_type {};
+
+template <typename I>
+struct is_selector<indirect_selector<I>> : public std::true_type {};
+
+template <>
+struct is_selector<mask_selector> : public std::true_type {};
+
+// Prefetch<V>::at(x, idx) asks for element idx of a leaf to be brought into
+// cache; it does nothing for nodes that are computed rather than stored
+template <typename V>
+struct Prefetch {
+    static void at(const V&, uint64_t) {}
+};
+
+template <typename T, typename Alloc>
+struct Prefetch<vector<T, Alloc>> {
+    static void at(const vector<T, Alloc>& x, uint64_t idx) { epl::prefetch(x.data() + idx); }
+};
+
+template <typename T, typename Alloc>
+struct Prefetch<split_complex<T, Alloc>> {
+    static void at(const split_complex<T, Alloc>& x, uint64_t idx) {
+        epl::prefetch(x.real_data() + idx);
+        epl::prefetch(x.imag_data() + idx);
+    }
+};
+
+template <typename V>
+struct Prefetch<Owned<V>> : public Prefetch<V> {};
+
+template <typename T>
+struct Prefetch<Span<T>> {
+    static void at(const Span<T>& x, uint64_t idx) { epl::prefetch(x.base + idx); }
+};
+
+template <typename T>
+struct Prefetch<SplitSpan<T>> {
+    static void at(const SplitSpan<T>& x, uint64_t idx) {
+        epl::prefetch(x.re + idx);
+        epl::prefetch(x.im + idx);
+    }
+};
+
+// SliceProxy shows the elements of V picked by a selector, as a lazy operand
+// and, when V is writable (a Span or another writable view), as the
+// destination of an assignment: a[slice(0, n, 3)] = b * 2 evaluates b * 2
+// straight into every third element of a. Contiguous selections read and
+// write whole packets of V; any other selection gathers and scatters lanes.
+// As with std::slice_array, a view destination that overlaps an operand at a
+// different position gives unspecified results (a valarray destination is
+// evaluated through a temporary instead, see VectorWrapper::evaluate).
+template <typename V, typename Selector>
+class SliceProxy {
+private:
+    ChooseRef<V> parent;
+    Selector selector;
+
+public:
+    using value_type = typename V::value_type;
+    using element_type = typename Access<V>::element_type;
+    static constexpr bool vectorizable = Access<V>::vectorizable;
+
+    uint64_t size() const {
+        return selector.size();
+    }
+
+    element_type operator[](uint64_t index) const {
+        return Access<V>::element(parent, selector.index(index));
+    }
+
+    element_type element(uint64_t index) const {
+        prefetch(index, 1);
+        return Access<V>::element(parent, selector.index(index));
+    }
+
+    epl::packet<element_type> packet(uint64_t index) const {
+        if (selector.contiguous()) {
+            return Access<V>::packet(parent, selector.index(index));
+        }
+        prefetch(index, epl::packet_traits<element_type>::size);
+        epl::packet<element_type> result = {};
+        for (uint64_t k = 0; k < epl::packet_traits<element_type>::size; ++k) {
+            result[k] = Access<V>::element(parent, selector.index(index + k));
+        }
+        return result;
+    }
+
+    // contiguous views pass on their parent's interior, shifted to view positions
+    IndexRange interior() const {
+        if (!selector.contiguous() || selector.size() == 0) {
+            return IndexRange::all();
+        }
+        IndexRange inner = Access<V>::interior(parent);
+        uint64_t first = selector.index(0);
+        uint64_t b = inner.begin > first ? inner.begin - first : 0;
+        uint64_t e = inner.end > first ? inner.end - first : 0;
+        return IndexRange{b, std::max(b, e)};
+    }
+
+    // only the identity selection reads each element at its own position
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        bool identity = selector.contiguous() && (selector.size() == 0 || selector.index(0) == 0);
+        return Access<V>::aliases(parent, lo, hi, shifted || !identity);
+    }
+
+    // false when positions repeat, here or in a view this one writes through
+    bool independent() const {
+        return !selector.repeats() && Store<V>::independent(parent);
+    }
+
+    void store(uint64_t index, const element_type& value) const {
+        Store<V>::element(parent, selector.index(index), value);
+    }
+
+    void store_packet(uint64_t index, const epl::packet<element_type>& value) const {
+        if (selector.contiguous()) {
+            Store<V>::packet(parent, selector.index(index), value);
+            return;
+        }
+        for (uint64_t k = 0; k < epl::packet_traits<element_type>::size; ++k) {
+            Store<V>::element(parent, selector.index(index + k), value[k]);
+        }
+    }
+
+    SliceProxy(ChooseRef<V> _p, Selector _s): parent(std::move(_p)), selector(std::move(_s)) {
+        if (selector.bound() > parent.size()) { throw std::out_of_range("slice out of range"); }
+    }
+
+    SliceProxy(const SliceProxy& that) = default;
+
+    SliceProxy(SliceProxy&& that) = default;
+
+    ~SliceProxy() = default;
+
+    const_iterator<SliceProxy> begin() const {
+        return const_iterator<SliceProxy>(*this, 0);
+    }
+
+    const_iterator<SliceProxy> end() const {
+        return const_iterator<SliceProxy>(*this, size());
+    }
+
+private:
+    // requests the elements that will be read Selector::lookahead positions on
+    void prefetch(uint64_t index, uint64_t count) const {
+        if (Selector::lookahead == 0) { return; }
+        uint64_t ahead = index + Selector::lookahead;
+        for (uint64_t k = ahead; k < ahead + count && k < selector.size(); ++k) {
+            Prefetch<V>::at(parent, selector.index(k));
+        }
+    }
+};
+
+// the node a view of a modifiable V refers to: vectors are written through a
+// Span (a SplitSpan for split storage), anything else (proxies, other views)
+// is held as it is
+template <typename V>
+struct writable_leaf {
+    using type = V;
+    static const V& make(V& x) { return x; }
+};
+
+template <typename T, typename Alloc>
+struct writable_leaf<vector<T, Alloc>> {
+    using type = Span<T>;
+    static type make(vector<T, Alloc>& x) { return type{x.data(), x.size()}; }
+};
+
+template <typename T, typename Alloc>
+struct writable_leaf<split_complex<T, Alloc>> {
+    using type = SplitSpan<T>;
+    static type make(split_complex<T, Alloc>& x) { return x.span(); }
+};
+
+template <typename V>
+using WritableLeaf = typename writable_leaf<V>::type;
+
+
+// Boundary policies say what a shift reads past either end of its operand:
+// zero_boundary a value-initialized element (std::valarray::shift),
+// clamp_boundary the nearest end element, periodic_boundary wraps around
+// (std::valarray::cshift). pos is outside [0, n) and n is at least 1.
+struct zero_boundary {
+    template <typename V>
+    static typename Access<V>::element_type outside(const V&, int64_t, uint64_t) {
+        return typename Access<V>::element_type();
+    }
+};
+
+struct clamp_boundary {
+    template <typename V>
+    static typename Access<V>::element_type outside(const V& x, int64_t pos, uint64_t n) {
+        return Access<V>::element(x, pos < 0 ? 0 : n - 1);
+    }
+};
+
+struct periodic_boundary {
+    template <typename V>
+    static typename Access<V>::element_type outside(const V& x, int64_t pos, uint64_t n) {
+        int64_t r = pos % (int64_t) n;
+        return Access<V>::element(x, (uint64_t) (r < 0 ? r + (int64_t) n : r));
+    }
+};
+
+// ShiftProxy reads element i + offset of V, applying the Boundary policy to
+// positions past either end. Its interior is where i + offset stays inside V
+// (and inside V's own interior); there packet() reads V directly, with no
+// bounds checks, so stencils such as u + k * (shift(u, 1) - 2 * u + shift(u, -1))
+// vectorize everywhere except the few elements next to the ends.
+template <typename V, typename Boundary>
+class ShiftProxy {
+private:
+    ChooseRef<V> parent;
+    int64_t offset;
+
+public:
+    using value_type = typename V::value_type;
+    using element_type = typename Access<V>::element_type;
+    static constexpr bool vectorizable = Access<V>::vectorizable;
+
+    uint64_t size() const {
+        return parent.size();
+    }
+
+    element_type operator[](uint64_t index) const {
+        return element(index);
+    }
+
+    element_type element(uint64_t index) const {
+        int64_t pos = (int64_t) index + offset;
+        if (pos >= 0 && (uint64_t) pos < parent.size()) {
+            return Access<V>::element(parent, (uint64_t) pos);
+        }
+        return Boundary::outside(parent, pos, parent.size());
+    }
+
+    epl::packet<element_type> packet(uint64_t index) const {
+        return Access<V>::packet(parent, (uint64_t) ((int64_t) index + offset));
+    }
+
+    IndexRange interior() const {
+        IndexRange inner = Access<V>::interior(parent) & IndexRange{0, parent.size()};
+        int64_t b = (int64_t) inner.begin - offset;
+        int64_t e = (int64_t) inner.end - offset;
+        uint64_t begin = b < 0 ? 0 : (uint64_t) b;
+        uint64_t end = e < 0 ? 0 : (uint64_t) e;
+        return IndexRange{begin, std::max(begin, end)};
+    }
+
+    bool aliases(const void* lo, const void* hi, bool shifted) const {
+        return Access<V>::aliases(parent, lo, hi, shifted || offset != 0);
+    }
+
+    ShiftProxy(ChooseRef<V> _p, int64_t _offset): parent(std::move(_p)), offset(_offset) {}
+
+    ShiftProxy(const ShiftProxy& that) = default;
+
+    ShiftProxy(ShiftProxy&& that) = default;
+
+    ~ShiftProxy() = default;
+
+    const_iterator<ShiftProxy> begin() const {
+        return const_iterator<ShiftProxy>(*this, 0);
+    }
+
+    const_iterator<ShiftProxy> end() const {
+        return const_iterator<ShiftProxy>(*this, size());
+    }
+};
+
+
+// LeafOf<T> is the node an operand of (forwarded) type T is stored as inside a
+// proxy: lvalue valarrays by reference, rvalue valarrays as Owned leaves, other
+// proxies by value (moved when they are temporaries) and scalars as Scalar
+template <typename T, bool = Rank<typename std::decay<T>::type>::value != 0>
+struct scalar_leaf {};
+
+template <typename T>
+struct scalar_leaf<T, true> {
+    using type = Scalar<typename std::decay<T>::type>;
+    static type make(const T& x) { return type(x); }
+};
+
+template <typename T>
+struct leaf_of : public scalar_leaf<T> {};
+
+template <typename V>
+struct leaf_of<VectorWrapper<V>&> {
+    using type = V;
+    static const V& make(const VectorWrapper<V>& x) { return x; }
+};
+
+template <typename V>
+struct leaf_of<const VectorWrapper<V>&> : public leaf_of<VectorWrapper<V>&> {};
+
+template <typename V>
+struct leaf_of<const VectorWrapper<V>> : public leaf_of<VectorWrapper<V>&> {};
+
+template <typename V>
+struct leaf_of<VectorWrapper<V>> {
+    using type = V;
+    static V make(VectorWrapper<V>&& x) { return std::move(x); }
+};
+
+template <typename T, typename Alloc>
+struct leaf_of<VectorWrapper<vector<T, Alloc>>> {
+    using type = Owned<vector<T, Alloc>>;
+    static type make(VectorWrapper<vector<T, Alloc>>&& x) { return type(std::move(x)); }
+};
+
+template <typename T, typename Alloc>
+struct leaf_of<VectorWrapper<split_complex<T, Alloc>>> {
+    using type = Owned<split_complex<T, Alloc>>;
+    static type make(VectorWrapper<split_complex<T, Alloc>>&& x) { return type(std::move(x)); }
+};
+
+template <typename T>
+using LeafOf = typename leaf_of<T>::type;
+
+
+// Rewrites the operators apply while building a node, so that the expression
+// does less work per element than it spells out:
+//     (x op s1) op s2  ->  x op (s1 op s2)   for op + or *, scalars on either side
+//     (x - s1) - s2    ->  x - (s1 + s2)
+//     x / s            ->  x * (1 / s), or a multiply-and-shift for int (see divided_by)
+//     x + (-y), x - (-y)  ->  x - y, x + y
+//     -(-x)            ->  x
+//     -(x * s)         ->  x * (-s)
+// Only operands that are temporaries of the same expression are rewritten; a
+// node bound to a name is read through a reference, as written. Scalars are
+// values known only at run time, so x * 1 and x + 0 keep their node.
+//
+// Regrouping floating point scalars is not a matter of the last bit: it
+// changes which intermediate results overflow, underflow or cancel
+// ((x + 1e16) - 1e16 is not x + 0), so it only applies to integers unless
+// EPL_FAST_FP is defined. Multiplying by 1 / s instead of dividing by s can
+// change the last bit, and is only done when 1 / s is finite and normal;
+// EPL_STRICT_FP divides as written. The other rules are exact.
+template <typename V>
+struct is_scalar : public std::false_type {};
+
+template <typename T>
+struct is_scalar<Scalar<T>> : public std::true_type {};
+
+template <typename T>
+struct reassociable : public std::integral_constant<bool, std::is_integral<T>::value
+#if defined(EPL_FAST_FP) && !defined(EPL_STRICT_FP)
+    || std::is_floating_point<T>::value
+#endif
+    > {};
+
+// folds<Operator>: whether (x op s1) op s2 folds, and into which scalar
+template <typename Operator>
+struct folds : public std::false_type {
+    static constexpr bool commutative = false;
+};
+
+template <typename T>
+struct folds<std::plus<T>> : public reassociable<T> {
+    static constexpr bool commutative = true;
+    static T combine(T a, T b) { return a + b; }
+};
+
+template <typename T>
+struct folds<std::multiplies<T>> : public reassociable<T> {
+    static constexpr bool commutative = true;
+    static T combine(T a, T b) { return a * b; }
+};
+
+template <typename T>
+struct folds<std::minus<T>> : public reassociable<T> {
+    static constexpr bool commutative = false;
+    static T combine(T a, T b) { return a + b; }
+};
+
+// scalar_node<V, Operator> matches a temporary x op s, or s op x when op
+// commutes: operand() takes x's node out of it and scalar() gives s
+template <typename V, typename Operator>
+struct scalar_node : public std::false_type {};
+
+template <typename X, typename S, typename Operator>
+struct scalar_node<VectorWrapper<BinaryProxy<X, Scalar<S>, Operator>>, Operator> : public std::true_type {
+    using operand_type = X;
+    static ChooseRef<X> operand(BinaryProxy<X, Scalar<S>, Operator>&& p) { return std::move(p.l); }
+    static S scalar(const BinaryProxy<X, Scalar<S>, Operator>& p) { return p.r[0]; }
+};
+
+template <typename S, typename X, typename Operator>
+struct scalar_node<VectorWrapper<BinaryProxy<Scalar<S>, X, Operator>>, Operator> : public std::integral_constant<bool, folds<Operator>::commutative> {
+    using operand_type = X;
+    static ChooseRef<X> operand(BinaryProxy<Scalar<S>, X, Operator>&& p) { return std::move(p.r); }
+    static S scalar(const BinaryProxy<Scalar<S>, X, Operator>& p) { return p.l[0]; }
+};
+
+// negated_node<V, T> matches a temporary -y on T; operand() takes y's node out of it
+template <typename V, typename T>
+struct negated_node : public std::false_type {};
+
+template <typename Y, typename T>
+struct negated_node<VectorWrapper<UnaryProxy<Y, std::negate<T>>>, T> : public std::true_type {
+    using operand_type = Y;
+    static ChooseRef<Y> operand(UnaryProxy<Y, std::negate<T>>&& p) { return std::move(p.parent); }
+};
+
+// negation<V> is the node of -x for a temporary x of node V
+template <typename V, typename = void>
+struct negation {
+    using type = UnaryProxy<LeafOf<VectorWrapper<V>>, std::negate<typename V::value_type>>;
+    static type make(VectorWrapper<V>&& x) { return type(leaf_of<VectorWrapper<V>>::make(std::move(x)), std::negate<typename V::value_type>{}); }
+};
+
+// -(-x) is x itself when the inner negation held it by value, +x when by reference
+template <typename X, typename T>
+struct negation<UnaryProxy<X, std::negate<T>>, void> {
+    static constexpr bool by_value = !std::is_reference<ChooseRef<X>>::value;
+    using type = typename std::conditional<by_value, X, UnaryProxy<X, positive<T>>>::type;
+
+    static type make(VectorWrapper<UnaryProxy<X, std::negate<T>>>&& x) {
+        return type(make(std::move(x.parent), std::integral_constant<bool, by_value>{}));
+    }
+
+private:
+    static X make(ChooseRef<X>&& x, std::true_type) { return std::move(x); }
+    static UnaryProxy<X, positive<T>> make(ChooseRef<X> x, std::false_type) { return UnaryProxy<X, positive<T>>(x, positive<T>{}); }
+};
+
+template <typename X, typename S, typename T>
+struct negation<BinaryProxy<X, Scalar<S>, std::multiplies<T>>, EnableIf<std::is_arithmetic<T>::value, void>> {
+    using type = BinaryProxy<X, Scalar<T>, std::multiplies<T>>;
+
+    static type make(VectorWrapper<BinaryProxy<X, Scalar<S>, std::multiplies<T>>>&& x) {
+        using Node = scalar_node<VectorWrapper<BinaryProxy<X, Scalar<S>, std::multiplies<T>>>, std::multiplies<T>>;
+        T s = Node::scalar(x);
+        return type(Node::operand(std::move(x)), Scalar<T>(-s), std::multiplies<T>{});
+    }
+};
+
+template <typename S, typename X, typename T>
+struct negation<BinaryProxy<Scalar<S>, X, std::multiplies<T>>, EnableIf<std::is_arithmetic<T>::value, void>> {
+    using type = BinaryProxy<X, Scalar<T>, std::multiplies<T>>;
+
+    static type make(VectorWrapper<BinaryProxy<Scalar<S>, X, std::multiplies<T>>>&& x) {
+        using Node = scalar_node<VectorWrapper<BinaryProxy<Scalar<S>, X, std::multiplies<T>>>, std::multiplies<T>>;
+        T s = Node::scalar(x);
+        return type(Node::operand(std::move(x)), Scalar<T>(-s), std::multiplies<T>{});
+    }
+};
+
+
+// Cost<E> describes the work in an expression tree, per element, at compile time:
+//     depth    nodes on the longest path from the root to a leaf
+//     leaves   operands that are read (arrays, views' parents, scalars)
+//     flops    operations, weighted by epl::operation_cost
+//     bytes    memory read (scalars stay in registers)
+template <typename T>
+struct Cost {
+    static constexpr uint64_t depth = 1;
+    static constexpr uint64_t leaves = 1;
+    static constexpr uint64_t flops = 0;
+    static constexpr uint64_t bytes = sizeof(typename Access<T>::element_type);
+};
+
+template <typename V>
+struct Cost<Owned<V>> : public Cost<V> {};
+
+template <typename T>
+struct Cost<Scalar<T>> {
+    static constexpr uint64_t depth = 1;
+    static constexpr uint64_t leaves = 1;
+    static constexpr uint64_t flops = 0;
+    static constexpr uint64_t bytes = 0;
+};
+
+template <typename T, typename Operator>
+struct Cost<UnaryProxy<T, Operator>> {
+    static constexpr uint64_t depth = Cost<T>::depth + 1;
+    static constexpr uint64_t leaves = Cost<T>::leaves;
+    static constexpr uint64_t flops = Cost<T>::flops + epl::operation_cost<Operator>::value;
+    static constexpr uint64_t bytes = Cost<T>::bytes;
+};
+
+template <typename Left, typename Right, typename Operator>
+struct Cost<BinaryProxy<Left, Right, Operator>> {
+    static constexpr uint64_t depth = std::max(Cost<Left>::depth, Cost<Right>::depth) + 1;
+    static constexpr uint64_t leaves = Cost<Left>::leaves + Cost<Right>::leaves;
+    static constexpr uint64_t flops = Cost<Left>::flops + Cost<Right>::flops + epl::operation_cost<Operator>::value;
+    static constexpr uint64_t bytes = Cost<Left>::bytes + Cost<Right>::bytes;
+};
+
+template <typename Left, typename Right, typename Addend, typename Operator>
+struct Cost<FmaProxy<Left, Right, Addend, Operator>> {
+    static constexpr uint64_t depth = std::max(Cost<Left>::depth, std::max(Cost<Right>::depth, Cost<Addend>::depth)) + 1;
+    static constexpr uint64_t leaves = Cost<Left>::leaves + Cost<Right>::leaves + Cost<Addend>::leaves;
+    static constexpr uint64_t flops = Cost<Left>::flops + Cost<Right>::flops + Cost<Addend>::flops + epl::operation_cost<Operator>::value;
+    static constexpr uint64_t bytes = Cost<Left>::bytes + Cost<Right>::bytes + Cost<Addend>::bytes;
+};
+
+template <typename V, typename Selector>
+struct Cost<SliceProxy<V, Selector>> {
+    static constexpr uint64_t depth = Cost<V>::depth + 1;
+    static constexpr uint64_t leaves = Cost<V>::leaves;
+    static constexpr uint64_t flops = Cost<V>::flops;
+    static constexpr uint64_t bytes = Cost<V>::bytes + Selector::index_bytes;
+};
+
+template <typename V, typename Boundary>
+struct Cost<ShiftProxy<V, Boundary>> {
+    static constexpr uint64_t depth = Cost<V>::depth + 1;
+    static constexpr uint64_t leaves = Cost<V>::leaves;
+    static constexpr uint64_t flops = Cost<V>::flops;
+    static constexpr uint64_t bytes = Cost<V>::bytes;
+};
+
+template <typename Mask, typename Left, typename Right>
+struct Cost<WhereProxy<Mask, Left, Right>> {
+    static constexpr uint64_t depth = std::max(Cost<Mask>::depth, std::max(Cost<Left>::depth, Cost<Right>::depth)) + 1;
+    static constexpr uint64_t leaves = Cost<Mask>::leaves + Cost<Left>::leaves + Cost<Right>::leaves;
+    static constexpr uint64_t flops = Cost<Mask>::flops + Cost<Left>::flops + Cost<Right>::flops + 1;
+    static constexpr uint64_t bytes = Cost<Mask>::bytes + Cost<Left>::bytes + Cost<Right>::bytes;
+};
+
+// Strategy<E, T> decides how an expression E written to elements of T is run.
+// work is its cost per element (operations plus one unit per 8 bytes moved,
+// the write included); an expression is split between threads once size * work
+// reaches what epl::parallel_threshold() elements of dst = a + b on doubles
+// (4 units each) would cost, so compute-heavy expressions go parallel at
+// smaller sizes than bandwidth-bound ones. Chunks are kept to at least
+// min_task units of work, in whole cache lines of T.
+template <typename E, typename T>
+struct Strategy {
+    static constexpr uint64_t work = Cost<E>::flops + (Cost<E>::bytes + sizeof(T) + 7) / 8;
+    static constexpr uint64_t reference_work = 4;
+    static constexpr uint64_t min_task = 1 << 14;
+    static constexpr uint64_t line = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+    static bool parallel(uint64_t size) {
+        uint64_t threshold = epl::parallel_threshold();
+        if (threshold > std::numeric_limits<uint64_t>::max() / reference_work) {
+            return false;
+        }
+        return size >= threshold * reference_work / work;
+    }
+
+    static uint64_t grain(void) {
+        uint64_t elements = (min_task + work - 1) / work;
+        return (elements + line - 1) / line * line;
+    }
+};
+
+// Evaluator writes expr[0, size) into dst, a pointer or any other destination
+// handle Store describes. Whenever the expression produces the destination's
+// element type and every node has a packet form, the bulk of a range is
+// computed a packet at a time and only the tail runs element-wise.
+// Ranges that Strategy deems large enough are split into disjoint
+// chunks of dst and handed to the thread pool; the proxies are pure functions of
+// the index, so the chunks need no coordination. A destination whose elements
+// are not independent is written strictly in index order, one at a time.
+struct Evaluator {
+    template <typename D, typename E>
+    static void assign(D dst, const E& expr, uint64_t size) {
+        using T = typename Store<D>::element_type;
+        if (!Store<D>::independent(dst)) {
+            assign_range(dst, expr, 0, size, std::false_type{});
+        } else if (!Strategy<E, T>::parallel(size)) {
+            assign_range(dst, expr, 0, size);
+        } else {
+            // whole cache lines per chunk keep threads off each other's lines
+            epl::parallel_for(0, size, Strategy<E, T>::grain(), [&dst, &expr](uint64_t begin, uint64_t end) {
+                assign_range(dst, expr, begin, end);
+            });
+        }
+    }
+
+    template <typename D, typename E>
+    static void assign_range(const D& dst, const E& expr, uint64_t begin, uint64_t end) {
+        using vectorize = std::integral_constant<bool, Access<E>::vectorizable && std::is_same<typename Store<D>::element_type, typename Access<E>::element_type>::value>;
+        assign_range(dst, expr, begin, end, vectorize{});
+    }
+
+private:
+    // packets cover the part of [begin, end) inside the expression's interior;
+    // the elements on either side of it (next to the ends of a shift) and the
+    // tail go through element()
+    template <typename D, typename E>
+    static void assign_range(const D& dst, const E& expr, uint64_t begin, uint64_t end, std::true_type) {
+        constexpr uint64_t width = epl::packet_traits<typename Store<D>::element_type>::size;
+        IndexRange inner = Access<E>::interior(expr) & IndexRange{begin, end};
+        uint64_t lo = std::min(inner.begin, end);
+        uint64_t hi = std::min(inner.end, end);
+        uint64_t idx = begin;
+        for (; idx < lo; ++idx) {
+            Store<D>::element(dst, idx, Access<E>::element(expr, idx));
+        }
+        for (; idx + width <= hi; idx += width) {
+            Store<D>::packet(dst, idx, Access<E>::packet(expr, idx));
+        }
+        for (; idx < end; ++idx) {
+            Store<D>::element(dst, idx, Access<E>::element(expr, idx));
+        }
+    }
+
+    template <typename D, typename E>
+    static void assign_range(const D& dst, const E& expr, uint64_t begin, uint64_t end, std::false_type) {
+        using T = typename Store<D>::element_type;
+        for (uint64_t idx = begin; idx < end; ++idx) {
+            Store<D>::element(dst, idx, static_cast<T>(Access<E>::element(expr, idx)));
+        }
+    }
+};
+
+
+// FusedEvaluator writes several expressions, each into its own destination,
+// in one sweep: the common range is cut into blocks small enough for every
+// operand's share to stay in L1, and within a block each expression is written
+// in turn with Evaluator's kernels. An input that several expressions read is
+// fetched from memory once per block and re-read from cache, instead of being
+// streamed once per assignment. Pair k writes sizes[k] elements; whatever lies
+// past the shortest is finished pair by pair. The caller guarantees that no
+// expression reads another's destination (see tie). Destinations whose
+// elements are not independent are written one after the other by Evaluator.
+struct FusedEvaluator {
+    static constexpr uint64_t block = 512;
+
+    template <typename... D, typename... E>
+    static void assign(const std::tuple<D...>& dst, const std::tuple<E...>& expr, const uint64_t* sizes) {
+        static_assert(sizeof...(D) == sizeof...(E), "one destination per expression");
+        assign(dst, expr, sizes, std::index_sequence_for<E...>{});
+    }
+
+private:
+    template <typename... D, typename... E, size_t... I>
+    static void assign(const std::tuple<D...>& dst, const std::tuple<E...>& expr, const uint64_t* sizes, std::index_sequence<I...>) {
+        bool independent = true;
+        int check[] = { (independent = independent && Store<D>::independent(std::get<I>(dst)), 0)... };
+        (void) check;
+        if (!independent) {
+            int each[] = { (Evaluator::assign(std::get<I>(dst), std::get<I>(expr), sizes[I]), 0)... };
+            (void) each;
+            return;
+        }
+
+        uint64_t common = *std::min_element(sizes, sizes + sizeof...(E));
+        auto body = [&dst, &expr](uint64_t begin, uint64_t end) {
+            for (uint64_t b = begin; b < end; b += block) {
+                uint64_t e = std::min(end, b + block);
+                int each[] = { (Evaluator::assign_range(std::get<I>(dst), std::get<I>(expr), b, e), 0)... };
+                (void) each;
+            }
+        };
+
+        // the Strategy rule applied to the work of all the expressions together;
+        // chunks are whole blocks
+        uint64_t work = 0;
+        int sum[] = { (work += Strategy<typename std::decay<E>::type, typename Store<D>::element_type>::work, 0)... };
+        (void) sum;
+        constexpr uint64_t reference_work = 4;
+        constexpr uint64_t min_task = 1 << 14;
+        uint64_t threshold = epl::parallel_threshold();
+        if (threshold > std::numeric_limits<uint64_t>::max() / reference_work || common < threshold * reference_work / work) {
+            body(0, common);
+        } else {
+            uint64_t elements = (min_task + work - 1) / work;
+            epl::parallel_for(0, common, (elements + block - 1) / block * block, body);
+        }
+
+        int rest[] = { (Evaluator::assign_range(std::get<I>(dst), std::get<I>(expr), common, sizes[I]), 0)... };
+        (void) rest;
+    }
+};
+
+
+namespace epl {
+// fast lets each thread reduce one contiguous chunk, so the grouping of the
+// partial results (and floating point rounding) follows the thread count.
+// deterministic reduces fixed-size blocks and combines them in a fixed tree,
+// giving bit-identical results for any number of threads.
+enum class reduction_mode { fast, deterministic };
+
+inline std::atomic<reduction_mode>& reduction_mode_storage(void) {
+    static std::atomic<reduction_mode> mode{reduction_mode::deterministic};
+    return mode;
+}
+
+inline reduction_mode current_reduction_mode(void) { return reduction_mode_storage(); }
+
+inline void set_reduction_mode(reduction_mode mode) { reduction_mode_storage() = mode; }
+}
+
+// Reduction folds expr[0, size) with op. Operators that reduction_traits marks
+// associative are split into independent accumulators (four packets wide when
+// the expression vectorizes) and across threads, with the partial results
+// merged pairwise. Any other operator is applied strictly left to right,
+// starting from the first element.
+template <typename Operator>
+struct Reduction {
+    using result_type = typename Operator::result_type;
+
+    static constexpr uint64_t block = 4096; // deterministic mode's unit of work
+
+    template <typename E>
+    static result_type reduce(const E& expr, uint64_t size, const Operator& op) {
+        return reduce(expr, size, op, std::integral_constant<bool, epl::reduction_traits<Operator>::associative>{});
+    }
+
+private:
+    template <typename E>
+    static result_type reduce(const E& expr, uint64_t size, const Operator& op, std::false_type) {
+        result_type res = Access<E>::element(expr, 0);
+        for (uint64_t idx = 1; idx < size; ++idx) {
+            res = op(res, Access<E>::element(expr, idx));
+        }
+        return res;
+    }
+
+    template <typename E>
+    static result_type reduce(const E& expr, uint64_t size, const Operator& op, std::true_type) {
+        bool parallel = Strategy<E, result_type>::parallel(size) && epl::num_threads() > 1;
+        if (epl::current_reduction_mode() == epl::reduction_mode::fast) {
+            if (!parallel) { return reduce_range(expr, 0, size, op); }
+            return reduce_chunks(expr, size, op);
+        }
+
+        uint64_t blocks = (size + block - 1) / block;
+        if (!parallel) {
+            Combiner combine(op);
+            for (uint64_t k = 0; k < blocks; ++k) {
+                combine.push(reduce_range(expr, k * block, std::min(size, (k + 1) * block), op));
+            }
+            return combine.result();
+        }
+
+        std::vector<result_type> partial(blocks);
+        epl::parallel_for(0, blocks, 1, [&](uint64_t first, uint64_t last) {
+            for (uint64_t k = first; k < last; ++k) {
+                partial[k] = reduce_range(expr, k * block, std::min(size, (k + 1) * block), op);
+            }
+        });
+        Combiner combine(op);
+        for (const result_type& p : partial) { combine.push(p); }
+        return combine.result();
+    }
+
+    template <typename E>
+    static result_type reduce_chunks(const E& expr, uint64_t size, const Operator& op) {
+        uint64_t chunks = epl::num_threads();
+        uint64_t chunk = (size + chunks - 1) / chunks;
+        std::vector<result_type> partial(chunks, epl::reduction_traits<Operator>::identity());
+        epl::thread_pool::global().run(chunks, [&](uint64_t k) {
+            uint64_t begin = std::min(size, k * chunk);
+            partial[k] = reduce_range(expr, begin, std::min(size, begin + chunk), op);
+        });
+        Combiner combine(op);
+        for (const result_type& p : partial) { combine.push(p); }
+        return combine.result();
+    }
+
+    // Combiner merges a stream of partial results pairwise, like a binary
+    // counter, so the shape of the tree depends only on how many were pushed.
+    class Combiner {
+        const Operator& op;
+        result_type stack[64];
+        uint64_t weight[64];
+        int top = 0;
+
+    public:
+        explicit Combiner(const Operator& _op) : op(_op) {}
+
+        void push(result_type value) {
+            stack[top] = value;
+            weight[top] = 1;
+            ++top;
+            while (top > 1 && weight[top - 1] == weight[top - 2]) {
+                stack[top - 2] = op(stack[top - 2], stack[top - 1]);
+                weight[top - 2] *= 2;
+                --top;
+            }
+        }
+
+        result_type result(void) const {
+            if (top == 0) { return epl::reduction_traits<Operator>::identity(); }
+            result_type res = stack[top - 1];
+            for (int k = top - 2; k >= 0; --k) {
+                res = op(stack[k], res);
+            }
+            return res;
+        }
+    };
+
+    template <typename E>
+    static result_type reduce_range(const E& expr, uint64_t begin, uint64_t end, const Operator& op) {
+        using vectorize = std::integral_constant<bool, Access<E>::vectorizable
+            && epl::packet_op<Operator>::value
+            && std::is_same<result_type, typename Access<E>::element_type>::value
+            && std::is_same<result_type, typename epl::packet_op<Operator>::value_type>::value>;
+        return reduce_range(expr, begin, end, op, vectorize{});
+    }
+
+    template <typename E>
+    static result_type reduce_range(const E& expr, uint64_t begin, uint64_t end, const Operator& op, std::true_type) {
+        using P = epl::packet<result_type>;
+        using Apply = epl::packet_op<Operator>;
+        constexpr uint64_t width = epl::packet_traits<result_type>::size;
+
+        // four independent accumulators hide the latency of the add/multiply chain
+        const P identity = epl::broadcast_packet(epl::reduction_traits<Operator>::identity());
+        P acc0 = identity, acc1 = identity, acc2 = identity, acc3 = identity;
+
+        // as in Evaluator, packets only within the expression's interior
+        IndexRange inner = Access<E>::interior(expr) & IndexRange{begin, end};
+        uint64_t lo = std::min(inner.begin, end);
+        uint64_t hi = std::min(inner.end, end);
+        result_type head = epl::reduction_traits<Operator>::identity();
+        uint64_t idx = begin;
+        for (; idx < lo; ++idx) {
+            head = op(head, Access<E>::element(expr, idx));
+        }
+        for (; idx + 4 * width <= hi; idx += 4 * width) {
+            acc0 = Apply::apply(op, acc0, Access<E>::packet(expr, idx));
+            acc1 = Apply::apply(op, acc1, Access<E>::packet(expr, idx + width));
+            acc2 = Apply::apply(op, acc2, Access<E>::packet(expr, idx + 2 * width));
+            acc3 = Apply::apply(op, acc3, Access<E>::packet(expr, idx + 3 * width));
+        }
+        for (; idx + width <= hi; idx += width) {
+            acc0 = Apply::apply(op, acc0, Access<E>::packet(expr, idx));
+        }
+        acc0 = Apply::apply(op, Apply::apply(op, acc0, acc1), Apply::apply(op, acc2, acc3));
+
+        for (uint64_t half = width / 2; half > 0; half /= 2) {
+            for (uint64_t k = 0; k < half; ++k) {
+                acc0[k] = op(acc0[k], acc0[k + half]);
+            }
+        }
+        result_type res = op(head, acc0[0]);
+        for (; idx < end; ++idx) {
+            res = op(res, Access<E>::element(expr, idx));
+        }
+        return res;
+    }
+
+    template <typename E>
+    static result_type reduce_range(const E& expr, uint64_t begin, uint64_t end, const Operator& op, std::false_type) {
+        const result_type identity = epl::reduction_traits<Operator>::identity();
+        result_type acc0 = identity, acc1 = identity, acc2 = identity, acc3 = identity;
+        uint64_t idx = begin;
+        for (; idx + 4 <= end; idx += 4) {
+            acc0 = op(acc0, Access<E>::element(expr, idx));
+            acc1 = op(acc1, Access<E>::element(expr, idx + 1));
+            acc2 = op(acc2, Access<E>::element(expr, idx + 2));
+            acc3 = op(acc3, Access<E>::element(expr, idx + 3));
+        }
+        for (; idx < end; ++idx) {
+            acc0 = op(acc0, Access<E>::element(expr, idx));
+        }
+        return op(op(acc0, acc1), op(acc2, acc3));
+    }
+};
+
+// MaskReduction answers any(), all() and count() for an expression whose
+// elements are tested for truth (see epl::truth): comparisons and logic a
+// packet of masks at a time, anything else element by element. The elements
+// are visited in blocks, and any() and all() return after the first block that
+// settles them; on inputs large enough to be split between threads, each
+// thread skips its remaining blocks once another has found the answer.
+struct MaskReduction {
+    static constexpr uint64_t block = 4096;
+
+    template <typename E>
+    static bool any(const E& expr, uint64_t size) {
+        return find(expr, size, true);
+    }
+
+    template <typename E>
+    static bool all(const E& expr, uint64_t size) {
+        return !find(expr, size, false);
+    }
+
+    template <typename E>
+    static uint64_t count(const E& expr, uint64_t size) {
+        uint64_t blocks = (size + block - 1) / block;
+        if (!parallel<E>(size)) {
+            return count_range(expr, 0, size, true);
+        }
+        std::vector<uint64_t> partial(blocks);
+        epl::parallel_for(0, blocks, 1, [&](uint64_t first, uint64_t last) {
+            for (uint64_t k = first; k < last; ++k) {
+                partial[k] = count_range(expr, k * block, std::min(size, (k + 1) * block), true);
+            }
+        });
+        uint64_t total = 0;
+        for (uint64_t p : partial) { total += p; }
+        return total;
+    }
+
+private:
+    template <typename E>
+    static bool parallel(uint64_t size) {
+        return Strategy<E, bool>::parallel(size) && epl::num_threads() > 1;
+    }
+
+    // true when an element's truth is wanted
+    template <typename E>
+    static bool find(const E& expr, uint64_t size, bool wanted) {
+        uint64_t blocks = (size + block - 1) / block;
+        if (!parallel<E>(size)) {
+            for (uint64_t k = 0; k < blocks; ++k) {
+                if (count_range(expr, k * block, std::min(size, (k + 1) * block), wanted) > 0) { return true; }
+            }
+            return false;
+        }
+        std::atomic<bool> found{false};
+        epl::parallel_for(0, blocks, 1, [&](uint64_t first, uint64_t last) {
+            for (uint64_t k = first; k < last && !found.load(std::memory_order_relaxed); ++k) {
+                if (count_range(expr, k * block, std::min(size, (k + 1) * block), wanted) > 0) {
+                    found.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+        return found.load();
+    }
+
+    // the elements of [begin, end) whose truth is wanted
+    template <typename E>
+    static uint64_t count_range(const E& expr, uint64_t begin, uint64_t end, bool wanted) {
+        using element_type = typename Access<E>::element_type;
+        using vectorize = std::integral_constant<bool, Access<E>::vectorizable
+            && epl::is_boolean<element_type>::value && epl::packet_traits<element_type>::vectorizable>;
+        return count_range(expr, begin, end, wanted, vectorize{});
+    }
+
+    // all-ones lanes are -1, so subtracting masks counts them; a block's
+    // count per lane stays far below the range of the lanes
+    template <typename E>
+    static uint64_t count_range(const E& expr, uint64_t begin, uint64_t end, bool wanted, std::true_type) {
+        using P = epl::packet<typename Access<E>::element_type>;
+        constexpr uint64_t width = epl::packet_traits<typename Access<E>::element_type>::size;
+        IndexRange inner = Access<E>::interior(expr) & IndexRange{begin, end};
+        uint64_t lo = std::min(inner.begin, end);
+        uint64_t hi = std::min(inner.end, end);
+        uint64_t total = 0;
+        uint64_t idx = begin;
+        for (; idx < lo; ++idx) {
+            total += epl::truth(Access<E>::element(expr, idx)) == wanted;
+        }
+        P acc = {};
+        for (; idx + width <= hi; idx += width) {
+            P lanes = Access<E>::packet(expr, idx);
+            acc -= wanted ? lanes : ~lanes;
+        }
+        for (uint64_t k = 0; k < width; ++k) {
+            total += (uint64_t) acc[k];
+        }
+        for (; idx < end; ++idx) {
+            total += epl::truth(Access<E>::element(expr, idx)) == wanted;
+        }
+        return total;
+    }
+
+    template <typename E>
+    static uint64_t count_range(const E& expr, uint64_t begin, uint64_t end, bool wanted, std::false_type) {
+        uint64_t total = 0;
+        for (uint64_t idx = begin; idx < end; ++idx) {
+            total += epl::truth(Access<E>::element(expr, idx)) == wanted;
+        }
+        return total;
+    }
+};
+
+
+// stats:: names the reducers reduce() takes. Each is a tag whose accumulator<T>
+// folds elements of T one at a time (element) or, when vectorizable, a packet
+// at a time (packet, each lane its own partial result); merge() appends the
+// accumulator of the range that follows, and result() gives the answer.
+//     sum, sumsq       sum of x and of x * x, blocked and merged pairwise
+//     min, max         smallest and largest element (T's extremes when empty)
+//     argmin, argmax   index of the first smallest or largest element (0 when
+//                      empty); with NaNs present, which one is unspecified
+//     mean, variance   Welford's running mean and population variance, in
+//                      double for integers (NaN when empty)
+namespace stats {
+namespace detail {
+template <typename T>
+inline T lane(const epl::packet<T>& p, uint64_t k, std::true_type) { return p[k]; }
+
+template <typename T>
+inline T lane(const T& p, uint64_t, std::false_type) { return p; }
+
+template <typename T>
+inline epl::packet<T> splat(const T& x, std::true_type) { return epl::broadcast_packet(x); }
+
+template <typename T>
+inline T splat(const T& x, std::false_type) { return x; }
+
+template <typename T>
+inline T worst(std::less<>) { return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(); }
+
+template <typename T>
+inline T worst(std::greater<>) { return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(); }
+}
+
+struct sum_t {
+    template <typename T>
+    struct accumulator {
+        using result_type = T;
+        static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable;
+
+        T value = T(0);
+        epl::packet<T> lanes = {};
+
+        void element(const T& x, uint64_t) { value = value + x; }
+
+        void packet(const epl::packet<T>& x, uint64_t) { lanes = lanes + x; }
+
+        void merge(const accumulator& later) {
+            value = result() + later.result();
+            lanes = epl::packet<T>{};
+        }
+
+        result_type result(void) const {
+            T res = value;
+            for (uint64_t k = 0; k < epl::packet_traits<T>::size; ++k) {
+                res = res + detail::lane<T>(lanes, k, std::integral_constant<bool, vectorizable>{});
+            }
+            return res;
+        }
+    };
+};
+
+struct sumsq_t {
+    template <typename T>
+    struct accumulator : public sum_t::accumulator<T> {
+        void element(const T& x, uint64_t idx) { sum_t::accumulator<T>::element(x * x, idx); }
+
+        void packet(const epl::packet<T>& x, uint64_t idx) { sum_t::accumulator<T>::packet(x * x, idx); }
+    };
+};
+
+namespace detail {
+// sumsq in FloatingType<T>, for norm2(): integer squares overflow long before
+// their root does, so integers are converted first and add up element by element
+struct floating_sumsq_t {
+    template <typename T>
+    struct accumulator : public sum_t::accumulator<FloatingType<T>> {
+        using F = FloatingType<T>;
+        static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable && std::is_same<F, T>::value;
+
+        void element(const T& x, uint64_t idx) { sum_t::accumulator<F>::element(F(x) * F(x), idx); }
+
+        void packet(const epl::packet<T>& x, uint64_t idx) { sum_t::accumulator<F>::packet(x * x, idx); }
+    };
+};
+}
+
+// Better is std::less<> for the minimum, std::greater<> for the maximum
+template <typename Better>
+struct extreme_t {
+    template <typename T>
+    struct accumulator {
+        using result_type = T;
+        static constexpr bool vectorizable = epl::boolean_packet<T>::vectorizable;
+
+        T value = detail::worst<T>(Better{});
+        epl::packet<T> lanes = detail::splat(detail::worst<T>(Better{}), std::integral_constant<bool, vectorizable>{});
+
+        void element(const T& x, uint64_t) { value = Better{}(x, value) ? x : value; }
+
+        void packet(const epl::packet<T>& x, uint64_t) { lanes = Better{}(x, lanes) ? x : lanes; }
+
+        void merge(const accumulator& later) {
+            T a = result(), b = later.result();
+            value = Better{}(b, a) ? b : a;
+            lanes = detail::splat(detail::worst<T>(Better{}), std::integral_constant<bool, vectorizable>{});
+        }
+
+        result_type result(void) const {
+            T res = value;
+            for (uint64_t k = 0; k < epl::packet_traits<T>::size; ++k) {
+                T x = detail::lane<T>(lanes, k, std::integral_constant<bool, vectorizable>{});
+                res = Better{}(x, res) ? x : res;
+            }
+            return res;
+        }
+    };
+};
+
+// the lanes keep each best element's offset from the first packet's index in
+// integers as wide as T, which a reduction block never outgrows
+template <typename Better>
+struct arg_extreme_t {
+    template <typename T>
+    struct accumulator {
+        using result_type = uint64_t;
+        static constexpr bool vectorizable = epl::boolean_packet<T>::vectorizable;
+        static constexpr uint64_t none = std::numeric_limits<uint64_t>::max();
+        using offsets = typename epl::boolean_packet<T>::type;
+        using offset_type = typename std::conditional<sizeof(T) == 8, int64_t, int32_t>::type;
+
+        T value = T();
+        uint64_t index = none;
+        epl::packet<T> lanes = {};
+        offsets at = {};
+        uint64_t base = none;
+
+        void element(const T& x, uint64_t idx) { take(x, idx); }
+
+        void packet(const epl::packet<T>& x, uint64_t idx) {
+            offsets here = {};
+            for (uint64_t k = 0; k < epl::packet_traits<T>::size; ++k) {
+                here[k] = offset_type(k);
+            }
+            if (base == none) {
+                base = idx;
+                lanes = x;
+                at = here;
+                return;
+            }
+            here += offset_type(idx - base);
+            auto better = Better{}(x, lanes);
+            lanes = better ? x : lanes;
+            at = better ? here : at;
+        }
+
+        void merge(const accumulator& later) {
+            fold();
+            accumulator rest = later;
+            rest.fold();
+            if (rest.index != none) { take(rest.value, rest.index); }
+        }
+
+        result_type result(void) const {
+            accumulator res = *this;
+            res.fold();
+            return res.index == none ? 0 : res.index;
+        }
+
+    private:
+        // the first of equally good elements wins, whatever order they come in
+        void take(const T& x, uint64_t idx) {
+            if (index == none || Better{}(x, value) || (x == value && idx < index)) {
+                value = x;
+                index = idx;
+            }
+        }
+
+        void fold(void) {
+            if (base != none) {
+                fold(std::integral_constant<bool, vectorizable>{});
+                base = none;
+            }
+        }
+
+        void fold(std::true_type) {
+            for (uint64_t k = 0; k < epl::packet_traits<T>::size; ++k) {
+                take(lanes[k], base + uint64_t(at[k]));
+            }
+        }
+
+        void fold(std::false_type) {}
+    };
+};
+
+// Welford's update in every lane; lanes and partial ranges are combined with
+// Chan et al.'s formula for merging counts, means and sums of squared deviations
+template <bool Variance>
+struct moments_t {
+    template <typename T>
+    struct accumulator {
+        using F = FloatingType<T>;
+        using result_type = F;
+        static constexpr bool vectorizable = epl::packet_traits<T>::vectorizable && std::is_floating_point<T>::value;
+
+        uint64_t n = 0;
+        F mean = F(0), m2 = F(0);
+        uint64_t lanes_n = 0;
+        typename std::conditional<vectorizable, epl::packet<T>, T>::type lanes_mean = {}, lanes_m2 = {};
+
+        void element(const T& x, uint64_t) {
+            ++n;
+            F delta = F(x) - mean;
+            mean += delta / F(n);
+            m2 += delta * (F(x) - mean);
+        }
+
+        void packet(const epl::packet<T>& x, uint64_t) {
+            ++lanes_n;
+            epl::packet<T> delta = x - lanes_mean;
+            lanes_mean = lanes_mean + delta * epl::broadcast_packet(T(1) / T(lanes_n));
+            lanes_m2 = lanes_m2 + delta * (x - lanes_mean);
+        }
+
+        void merge(const accumulator& later) {
+            fold();
+            accumulator rest = later;
+            rest.fold();
+            combine(rest.n, rest.mean, rest.m2);
+        }
+
+        result_type result(void) const {
+            accumulator res = *this;
+            res.fold();
+            if (res.n == 0) { return std::numeric_limits<F>::quiet_NaN(); }
+            return Variance ? res.m2 / F(res.n) : res.mean;
+        }
+
+    private:
+        void combine(uint64_t count, F other_mean, F other_m2) {
+            if (count == 0) { return; }
+            uint64_t total = n + count;
+            F delta = other_mean - mean;
+            mean += delta * (F(count) / F(total));
+            m2 += other_m2 + delta * delta * (F(n) * F(count) / F(total));
+            n = total;
+        }
+
+        void fold(void) {
+            if (lanes_n == 0) { return; }
+            for (uint64_t k = 0; k < epl::packet_traits<T>::size; ++k) {
+                combine(lanes_n, detail::lane<T>(lanes_mean, k, std::integral_constant<bool, vectorizable>{}),
+                        detail::lane<T>(lanes_m2, k, std::integral_constant<bool, vectorizable>{}));
+            }
+            lanes_n = 0;
+        }
+    };
+};
+
+constexpr sum_t sum{};
+constexpr sumsq_t sumsq{};
+constexpr extreme_t<std::less<>> min{};
+constexpr extreme_t<std::greater<>> max{};
+constexpr arg_extreme_t<std::less<>> argmin{};
+constexpr arg_extreme_t<std::greater<>> argmax{};
+constexpr moments_t<false> mean{};
+constexpr moments_t<true> variance{};
+}
+
+// FusedReduction computes every element of an expression once and feeds it to
+// all the stats:: accumulators asked for, a packet at a time when the
+// expression and every accumulator vectorize. As in Reduction's deterministic
+// mode, fixed-size blocks (split between threads when Strategy says so) are
+// merged in a fixed pairwise tree, so results do not depend on the thread count.
+struct FusedReduction {
+    static constexpr uint64_t block = 4096;
+
+    template <typename E, typename... Stats>
+    using Result = std::tuple<typename Stats::template accumulator<typename Access<E>::element_type>::result_type...>;
+
+    template <typename E, typename... Stats>
+    static Result<E, Stats...> reduce(const E& expr, uint64_t size, Stats...) {
+        using T = typename Access<E>::element_type;
+        using State = std::tuple<typename Stats::template accumulator<T>...>;
+        uint64_t blocks = (size + block - 1) / block;
+        Combiner<State> combine;
+        if (!(Strategy<E, T>::parallel(size) && epl::num_threads() > 1)) {
+            for (uint64_t k = 0; k < blocks; ++k) {
+                combine.push(reduce_range<State>(expr, k * block, std::min(size, (k + 1) * block)));
+            }
+        } else {
+            // cache line aligned, as the packets in State may be wider than new aligns
+            epl::vector<State, epl::aligned_allocator<>> partial(blocks);
+            epl::parallel_for(0, blocks, 1, [&](uint64_t first, uint64_t last) {
+                for (uint64_t k = first; k < last; ++k) {
+                    partial[k] = reduce_range<State>(expr, k * block, std::min(size, (k + 1) * block));
+                }
+            });
+            for (uint64_t k = 0; k < blocks; ++k) { combine.push(partial[k]); }
+        }
+        return results(combine.result(), std::index_sequence_for<Stats...>{});
+    }
+
+private:
+    template <bool... B>
+    struct flags {};
+
+    template <typename State, size_t... I>
+    static void merge(State& state, const State& later, std::index_sequence<I...>) {
+        int each[] = { (std::get<I>(state).merge(std::get<I>(later)), 0)... };
+        (void) each;
+    }
+
+    template <typename... A, size_t... I>
+    static std::tuple<typename A::result_type...> results(const std::tuple<A...>& state, std::index_sequence<I...>) {
+        return std::tuple<typename A::result_type...>(std::get<I>(state).result()...);
+    }
+
+    // as Reduction's Combiner, for the states of several accumulators
+    template <typename State>
+    class Combiner {
+        using all = std::make_index_sequence<std::tuple_size<State>::value>;
+        State stack[64];
+        uint64_t weight[64];
+        int top = 0;
+
+    public:
+        void push(const State& value) {
+            stack[top] = value;
+            weight[top] = 1;
+            ++top;
+            while (top > 1 && weight[top - 1] == weight[top - 2]) {
+                merge(stack[top - 2], stack[top - 1], all{});
+                weight[top - 2] *= 2;
+                --top;
+            }
+        }
+
+        State result(void) {
+            if (top == 0) { return State{}; }
+            for (int k = top - 2; k >= 0; --k) {
+                merge(stack[k], stack[k + 1], all{});
+            }
+            return stack[0];
+        }
+    };
+
+    template <typename State, typename E>
+    static State reduce_range(const E& expr, uint64_t begin, uint64_t end) {
+        return reduce_range<State>(expr, begin, end, std::make_index_sequence<std::tuple_size<State>::value>{});
+    }
+
+    template <typename State, typename E, size_t... I>
+    static State reduce_range(const E& expr, uint64_t begin, uint64_t end, std::index_sequence<I...> seq) {
+        using vectorize = std::integral_constant<bool, Access<E>::vectorizable
+            && std::is_same<flags<true, std::tuple_element<I, State>::type::vectorizable...>, flags<std::tuple_element<I, State>::type::vectorizable..., true>>::value>;
+        State state;
+        reduce_range(state, expr, begin, end, seq, vectorize{});
+        return state;
+    }
+
+    // as in Evaluator, packets only within the expression's interior
+    template <typename State, typename E, size_t... I>
+    static void reduce_range(State& state, const E& expr, uint64_t begin, uint64_t end, std::index_sequence<I...>, std::true_type) {
+        using T = typename Access<E>::element_type;
+        constexpr uint64_t width = epl::packet_traits<T>::size;
+        IndexRange inner = Access<E>::interior(expr) & IndexRange{begin, end};
+        uint64_t lo = std::min(inner.begin, end);
+        uint64_t hi = std::min(inner.end, end);
+        uint64_t idx = begin;
+        for (; idx < lo; ++idx) {
+            T x = Access<E>::element(expr, idx);
+            int each[] = { (std::get<I>(state).element(x, idx), 0)... };
+            (void) each;
+        }
+        for (; idx + width <= hi; idx += width) {
+            epl::packet<T> x = Access<E>::packet(expr, idx);
+            int each[] = { (std::get<I>(state).packet(x, idx), 0)... };
+            (void) each;
+        }
+        for (; idx < end; ++idx) {
+            T x = Access<E>::element(expr, idx);
+            int each[] = { (std::get<I>(state).element(x, idx), 0)... };
+            (void) each;
+        }
+    }
+
+    template <typename State, typename E, size_t... I>
+    static void reduce_range(State& state, const E& expr, uint64_t begin, uint64_t end, std::index_sequence<I...>, std::false_type) {
+        using T = typename Access<E>::element_type;
+        for (uint64_t idx = begin; idx < end; ++idx) {
+            T x = Access<E>::element(expr, idx);
+            int each[] = { (std::get<I>(state).element(x, idx), 0)... };
+            (void) each;
+        }
+    }
+};
+
+
+template <typename V>
+struct VectorWrapper : public V {
+    VectorWrapper() : V() {}
+
+    VectorWrapper(const V& that) : V(that) {}
+
+    VectorWrapper(V&& that) : V(std::move(that)) {}
+
+    VectorWrapper(const VectorWrapper& that) = default;
+
+    VectorWrapper(VectorWrapper&& that) = default;
+
+    explicit VectorWrapper(uint64_t size) : V(size) {}
+
+    // leaves trivially copyable elements unwritten, for arrays about to be overwritten
+    VectorWrapper(uint64_t size, epl::uninitialized_t) : V(size, epl::uninitialized) {}
+    
+
+    // different types: one allocation sized from the expression, filled in place
+    template <typename T>
+    VectorWrapper(const VectorWrapper<T>& that) : V(that.size(), epl::uninitialized) {
+        epl::instrumentation::materialized<typename V::value_type>();
+        Evaluator::assign(Store<V>::destination(*this), static_cast<const T&>(that), that.size());
+    }
+
+    VectorWrapper& operator=(const VectorWrapper<V>& that) {  // left and right are the same type
+        if ((void*)this != (void*)&that) {
+            uint64_t min_size = this->size() < that.size() ? this->size() : that.size();
+            Evaluator::assign(Store<V>::destination(*this), static_cast<const V&>(that), min_size);
+        }
+        return *this;
+    }
+
+    // a temporary of the same size hands over its buffer instead of being copied;
+    // otherwise, as with copy assignment, only the overlapping prefix is written.
+    // Views never hand over anything: assigning one writes the elements it shows.
+    VectorWrapper& operator=(VectorWrapper<V>&& that) {
+        if (this != &that) {
+            move_assign(std::move(that), std::integral_constant<bool, Store<V>::owner>{});
+        }
+        return *this;
+    }
+
+    template <typename T>
+    EnableIf<Rank<T>::value != 0, VectorWrapper&> operator=(const T& that) {
+        return this->operator=(VectorWrapper<Scalar<T>>(Scalar<T>(that)));
+    }
+
+    template <typename T>
+    VectorWrapper& operator=(const VectorWrapper<T>& that) {    // left and right are different types
+        if ((void*)this != (void*)&that) {
+            uint64_t min_size = this->size() < that.size() ? this->size() : that.size();
+            evaluate(static_cast<const T&>(that), min_size, std::integral_constant<bool, Store<V>::owner>{});
+        }
+        return *this;
+    }
+
+    // Compound assignment evaluates *this op that in one pass straight into this
+    // buffer, with the same kernels (and prefix-length rule) as operator=.
+    // Each element is read and written at the same index, so that may itself
+    // refer to *this: x += x * 2 doubles-and-adds every element exactly once.
+    template <typename T>
+    VectorWrapper& operator+=(T&& that) {
+        return *this = *this + std::forward<T>(that);
+    }
+
+    template <typename T>
+    VectorWrapper& operator-=(T&& that) {
+        return *this = *this - std::forward<T>(that);
+    }
+
+    template <typename T>
+    VectorWrapper& operator*=(T&& that) {
+        return *this = *this * std::forward<T>(that);
+    }
+
+    template <typename T>
+    VectorWrapper& operator/=(T&& that) {
+        return *this = *this / std::forward<T>(that);
+    }
+
+    using V::operator[];
+
+    // views of the elements a selector (slice, gslice) picks; on a modifiable
+    // valarray the view can also be assigned to
+    template <typename Selector>
+    EnableIf<is_selector<Selector>::value, VectorWrapper<SliceProxy<V, Selector>>> operator[](Selector s) const & {
+        return VectorWrapper<SliceProxy<V, Selector>>( SliceProxy<V, Selector>(*this, std::move(s)) );
+    }
+
+    template <typename Selector>
+    EnableIf<is_selector<Selector>::value, VectorWrapper<SliceProxy<WritableLeaf<V>, Selector>>> operator[](Selector s) & {
+        using Proxy = SliceProxy<WritableLeaf<V>, Selector>;
+        return VectorWrapper<Proxy>( Proxy(writable_leaf<V>::make(*this), std::move(s)) );
+    }
+
+    template <typename Selector>
+    EnableIf<is_selector<Selector>::value, VectorWrapper<SliceProxy<LeafOf<VectorWrapper>, Selector>>> operator[](Selector s) && {
+        using Proxy = SliceProxy<LeafOf<VectorWrapper>, Selector>;
+        return VectorWrapper<Proxy>( Proxy(leaf_of<VectorWrapper>::make(std::move(*this)), std::move(s)) );
+    }
+
+    template <typename Operator>
+    VectorWrapper<UnaryProxy<V, Operator>> apply(Operator op) const & {
+        return VectorWrapper<UnaryProxy<V, Operator>>( UnaryProxy<V, Operator>(*this, op) );
+    }
+
+    // on a temporary the operand is moved into the proxy (see leaf_of)
+    template <typename Operator>
+    VectorWrapper<UnaryProxy<LeafOf<VectorWrapper>, Operator>> apply(Operator op) && {
+        using Proxy = UnaryProxy<LeafOf<VectorWrapper>, Operator>;
+        return VectorWrapper<Proxy>( Proxy(leaf_of<VectorWrapper>::make(std::move(*this)), op) );
+    }
+
+
+    // the elementwise functions, on this array or expression and on a temporary
+    template <template <typename> class F>
+    using Mapped = VectorWrapper<UnaryProxy<V, F<typename V::value_type>>>;
+
+    template <template <typename> class F>
+    using MappedTemporary = VectorWrapper<UnaryProxy<LeafOf<VectorWrapper>, F<typename V::value_type>>>;
+
+    Mapped<root> sqrt(void) const & { return apply(root<typename V::value_type>{}); }
+    MappedTemporary<root> sqrt(void) && { return std::move(*this).apply(root<typename V::value_type>{}); }
+
+    // elements are real for complex arrays; the expression's value_type stays that of the array
+    Mapped<absolute> abs(void) const & { return apply(absolute<typename V::value_type>{}); }
+    MappedTemporary<absolute> abs(void) && { return std::move(*this).apply(absolute<typename V::value_type>{}); }
+
+    Mapped<exponential> exp(void) const & { return apply(exponential<typename V::value_type>{}); }
+    MappedTemporary<exponential> exp(void) && { return std::move(*this).apply(exponential<typename V::value_type>{}); }
+
+    Mapped<logarithm> log(void) const & { return apply(logarithm<typename V::value_type>{}); }
+    MappedTemporary<logarithm> log(void) && { return std::move(*this).apply(logarithm<typename V::value_type>{}); }
+
+    Mapped<sine> sin(void) const & { return apply(sine<typename V::value_type>{}); }
+    MappedTemporary<sine> sin(void) && { return std::move(*this).apply(sine<typename V::value_type>{}); }
+
+    Mapped<cosine> cos(void) const & { return apply(cosine<typename V::value_type>{}); }
+    MappedTemporary<cosine> cos(void) && { return std::move(*this).apply(cosine<typename V::value_type>{}); }
+
+    Mapped<hyperbolic_tangent> tanh(void) const & { return apply(hyperbolic_tangent<typename V::value_type>{}); }
+    MappedTemporary<hyperbolic_tangent> tanh(void) && { return std::move(*this).apply(hyperbolic_tangent<typename V::value_type>{}); }
+
+    Mapped<round_down> floor(void) const & { return apply(round_down<typename V::value_type>{}); }
+    MappedTemporary<round_down> floor(void) && { return std::move(*this).apply(round_down<typename V::value_type>{}); }
+
+    Mapped<round_up> ceil(void) const & { return apply(round_up<typename V::value_type>{}); }
+    MappedTemporary<round_up> ceil(void) && { return std::move(*this).apply(round_up<typename V::value_type>{}); }
+
+    VectorWrapper<UnaryProxy<V, std::negate<typename V::value_type>>> operator-(void) const & {
+        return apply(std::negate<typename V::value_type>{});
+    }
+
+    // a temporary may cancel or absorb the negation (see negation)
+    VectorWrapper<typename negation<V>::type> operator-(void) && {
+        return VectorWrapper<typename negation<V>::type>(negation<V>::make(std::move(*this)));
+    }
+
+    Mapped<complement> operator!(void) const & { return apply(complement<typename V::value_type>{}); }
+    MappedTemporary<complement> operator!(void) && { return std::move(*this).apply(complement<typename V::value_type>{}); }
+
+    template <typename T>
+    VectorWrapper(std::initializer_list<T> il) : V(il) {}
 
     ~VectorWrapper() = default;
     
+    // Computes every element once, into a buffer recycled through the thread's
+    // scratch pool (see epl::pool_scope), and returns it as a leaf: bound to a
+    // name it can feed several expressions, used in place it stops a costly
+    // subexpression from being recomputed by an enclosing one. Elements keep
+    // value_type, so results match the unevaluated expression.
+    valarray<typename V::value_type, epl::pool_allocator> eval(void) const {
+        return valarray<typename V::value_type, epl::pool_allocator>(*this);
+    }
 
     template <typename Operator>
     typename Operator::result_type accumulate(Operator op) {
         if (this->size() > 0) {
-            typename Operator::result_type res = this->operator[](0);
-            for (auto it = ++(this->begin()); it != this->end(); ++it)
-                res = op(res, *it);
-            return res;
+            return Reduction<Operator>::reduce(static_cast<const V&>(*this), this->size(), op);
         } else {
             return 0;
         }
@@ -367,47 +3038,504 @@ struct VectorWrapper : public V {
         return accumulate(std::plus<typename V::value_type>{});
     }
 
+    // whether any, or every, element is true (nonzero), and how many are
+    bool any() const {
+        return MaskReduction::any(static_cast<const V&>(*this), this->size());
+    }
+
+    bool all() const {
+        return MaskReduction::all(static_cast<const V&>(*this), this->size());
+    }
+
+    uint64_t count() const {
+        return MaskReduction::count(static_cast<const V&>(*this), this->size());
+    }
+
+    // the mean (NaN when empty), and the smallest and largest elements, each in
+    // one pass (see FusedReduction); reduce() computes any other combination
+    FloatingType<typename Access<V>::element_type> mean() const {
+        return std::get<0>(FusedReduction::reduce(static_cast<const V&>(*this), this->size(), stats::mean));
+    }
+
+    std::pair<typename Access<V>::element_type, typename Access<V>::element_type> minmax() const {
+        auto res = FusedReduction::reduce(static_cast<const V&>(*this), this->size(), stats::min, stats::max);
+        return std::make_pair(std::get<0>(res), std::get<1>(res));
+    }
+
+private:
+    // an expression that reads this array at other positions (a shift of it,
+    // say) is evaluated into a temporary first, so that no element is
+    // overwritten before its last read; u = u + shift(u, 1) then means what it says
+    template <typename E>
+    void evaluate(const E& expr, uint64_t size, std::true_type) {
+        std::pair<const void*, const void*> extent = Store<V>::extent(*this);
+        if (Access<E>::aliases(expr, extent.first, extent.second, false)) {
+            V temp(size, epl::uninitialized);
+            epl::instrumentation::materialized<typename V::value_type>();
+            Evaluator::assign(Store<V>::destination(temp), expr, size);
+            if (size == this->size()) {
+                V::operator=(std::move(temp));
+            } else {
+                Evaluator::assign(Store<V>::destination(*this), temp, size);
+            }
+            return;
+        }
+        Evaluator::assign(Store<V>::destination(*this), expr, size);
+    }
+
+    template <typename E>
+    void evaluate(const E& expr, uint64_t size, std::false_type) {
+        Evaluator::assign(Store<V>::destination(*this), expr, size);
+    }
+
+    void move_assign(VectorWrapper<V>&& that, std::true_type) {
+        if (this->size() == that.size()) {
+            V::operator=(std::move(that));
+        } else {
+            this->operator=(static_cast<const VectorWrapper<V>&>(that));
+        }
+    }
+
+    void move_assign(VectorWrapper<V>&& that, std::false_type) {
+        this->operator=(static_cast<const VectorWrapper<V>&>(that));
+    }
+
 };
 
 
+// a[indirect(idx)] shows a[idx[0]], a[idx[1]], ... for an index valarray that
+// must outlive the view (so temporaries are refused)
+template <typename I, typename Alloc>
+indirect_selector<I> indirect(const valarray<I, Alloc>& idx) {
+    static_assert(std::is_integral<I>::value, "indices must be integers");
+    return indirect_selector<I>(idx.data(), idx.size());
+}
+
+template <typename I, typename Alloc>
+indirect_selector<I> indirect(const valarray<I, Alloc>&& idx) = delete;
+
+// a[mask(m)] shows the elements of a where m (any valarray or expression) is nonzero
+template <typename V>
+mask_selector mask(const VectorWrapper<V>& m) {
+    std::vector<uint64_t> picked;
+    for (uint64_t i = 0; i < m.size(); ++i) {
+        if (m[i]) { picked.push_back(i); }
+    }
+    return mask_selector(std::move(picked));
+}
+
+// fusion<Operator>::side<T1, T2> is 1 when l op r can be fused as l = a * b,
+// 2 when as r = a * b, and 0 otherwise; op<side> is then the multiply_add.
+// Only temporary products on floating point elements of the sum's type fuse;
+// a product bound to a name is read through a reference, as any operand.
+template <typename V, typename T>
+struct is_product : public std::false_type {};
+
+template <typename L, typename R, typename T>
+struct is_product<VectorWrapper<BinaryProxy<L, R, std::multiplies<T>>>, T> : public std::is_floating_point<T> {};
+
 template <typename Operator>
-struct ZJType {
+struct fusion {
+    template <typename T1, typename T2>
+    using side = std::integral_constant<int, 0>;
+};
+
+#ifdef EPL_FMA
+template <typename T>
+struct fusion<std::plus<T>> {
+    template <typename T1, typename T2>
+    using side = std::integral_constant<int, is_product<T1, T>::value ? 1 : is_product<T2, T>::value ? 2 : 0>;
+
+    template <int Side>
+    using op = multiply_add<T>;
+};
+
+template <typename T>
+struct fusion<std::minus<T>> {
     template <typename T1, typename T2>
-    static VectorWrapper<BinaryProxy<T1, T2, Operator>> calculate(const VectorWrapper<T1>& l, const VectorWrapper<T2>& r) {
-        return VectorWrapper<BinaryProxy<T1, T2, Operator>>(BinaryProxy<T1, T2, Operator>(l, r, Operator{}));
+    using side = typename fusion<std::plus<T>>::template side<T1, T2>;
+
+    template <int Side>
+    using op = multiply_add<T, Side == 2 ? -1 : 1, Side == 1 ? -1 : 1>;
+};
+#endif
+
+// the other rewrites of l op r (see negation)
+template <typename Operator, typename V>
+struct negates : public std::false_type {};
+
+template <typename T, typename V>
+struct negates<std::plus<T>, V> : public negated_node<V, T> {
+    using flipped = std::minus<T>;
+};
+
+template <typename T, typename V>
+struct negates<std::minus<T>, V> : public negated_node<V, T> {
+    using flipped = std::plus<T>;
+};
+
+// int and floating point arrays divided by a scalar of their type (see divided_by)
+template <typename Operator, typename V>
+struct invariant_division : public std::false_type {};
+
+template <typename T, typename V>
+struct invariant_division<std::divides<T>, V> : public std::integral_constant<bool,
+    (std::is_same<T, int>::value
+#ifndef EPL_STRICT_FP
+     || std::is_floating_point<T>::value
+#endif
+    ) && std::is_same<typename LeafOf<V>::value_type, T>::value> {};
+
+template <typename T>
+using is_scalar_operand = std::integral_constant<bool, Rank<typename std::decay<T>::type>::value != 0>;
+
+namespace rewrite {
+enum { none, fused_left, fused_right, folded_left, folded_right, negated, divided };
+}
+
+template <typename Operator, typename T1, typename T2>
+struct rewrite_of {
+    static constexpr int value =
+        folds<Operator>::value && scalar_node<T1, Operator>::value && is_scalar_operand<T2>::value ? rewrite::folded_left
+        : folds<Operator>::value && folds<Operator>::commutative && is_scalar_operand<T1>::value && scalar_node<T2, Operator>::value ? rewrite::folded_right
+        : invariant_division<Operator, T1>::value && is_scalar_operand<T2>::value ? rewrite::divided
+        : negates<Operator, T2>::value ? rewrite::negated
+        : fusion<Operator>::template side<T1, T2>::value;
+};
+
+// BinaryNode<Operator, T1, T2> is the node of l op r: a BinaryProxy as
+// written, or what rewrite_of picks for it
+template <typename Operator, typename T1, typename T2, int Rule = rewrite_of<Operator, T1, T2>::value>
+struct BinaryNode {
+    using type = BinaryProxy<LeafOf<T1>, LeafOf<T2>, Operator>;
+
+    static type make(T1&& l, T2&& r) {
+        return type(leaf_of<T1>::make(std::forward<T1>(l)), leaf_of<T2>::make(std::forward<T2>(r)), Operator{});
+    }
+};
+
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::fused_left> {
+    using Product = LeafOf<T1>;
+    using type = FmaProxy<typename Product::left_type, typename Product::right_type, LeafOf<T2>, typename fusion<Operator>::template op<1>>;
+
+    static type make(T1&& l, T2&& r) {
+        return type(leaf_of<T1>::make(std::forward<T1>(l)), leaf_of<T2>::make(std::forward<T2>(r)));
+    }
+};
+
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::fused_right> {
+    using Product = LeafOf<T2>;
+    using type = FmaProxy<typename Product::left_type, typename Product::right_type, LeafOf<T1>, typename fusion<Operator>::template op<2>>;
+
+    static type make(T1&& l, T2&& r) {
+        return type(leaf_of<T2>::make(std::forward<T2>(r)), leaf_of<T1>::make(std::forward<T1>(l)));
+    }
+};
+
+// (x op s1) op s2
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::folded_left> {
+    using R = typename Operator::result_type;
+    using Node = scalar_node<T1, Operator>;
+    using type = BinaryProxy<typename Node::operand_type, Scalar<R>, Operator>;
+
+    static type make(T1&& l, T2&& r) {
+        R s = folds<Operator>::combine(R(Node::scalar(l)), R(r));
+        return type(Node::operand(std::move(l)), Scalar<R>(s), Operator{});
+    }
+};
+
+// s2 op (x op s1)
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::folded_right> {
+    using R = typename Operator::result_type;
+    using Node = scalar_node<T2, Operator>;
+    using type = BinaryProxy<typename Node::operand_type, Scalar<R>, Operator>;
+
+    static type make(T1&& l, T2&& r) {
+        R s = folds<Operator>::combine(R(l), R(Node::scalar(r)));
+        return type(Node::operand(std::move(r)), Scalar<R>(s), Operator{});
     }
+};
+
+// x / s, divided by a divisor prepared once
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::divided> {
+    using R = typename Operator::result_type;
+    using type = UnaryProxy<LeafOf<T1>, divided_by<R>>;
 
-    template <typename V, typename T>
-    static EnableIf<Rank<T>::value != 0, VectorWrapper<BinaryProxy<V, Scalar<T>, Operator>>> calculate(const VectorWrapper<V>& l, const T& r) {
-        return VectorWrapper<BinaryProxy<V, Scalar<T>, Operator>>(BinaryProxy<V, Scalar<T>, Operator>(l, VectorWrapper<Scalar<T>>(r), Operator{}));
+    static type make(T1&& l, T2&& r) {
+        return type(leaf_of<T1>::make(std::forward<T1>(l)), divided_by<R>(R(r)));
     }
+};
+
+// x + (-y) and x - (-y)
+template <typename Operator, typename T1, typename T2>
+struct BinaryNode<Operator, T1, T2, rewrite::negated> {
+    using Node = negates<Operator, T2>;
+    using type = BinaryProxy<LeafOf<T1>, typename Node::operand_type, typename Node::flipped>;
 
-    template <typename T, typename V>
-    static EnableIf<Rank<T>::value != 0, VectorWrapper<BinaryProxy<Scalar<T>, V, Operator>>> calculate(const T& l, const VectorWrapper<V>& r) {
-        return VectorWrapper<BinaryProxy<Scalar<T>, V, Operator>>(BinaryProxy<Scalar<T>, V, Operator>(VectorWrapper<Scalar<T>>(l), r, Operator{}));
+    static type make(T1&& l, T2&& r) {
+        return type(leaf_of<T1>::make(std::forward<T1>(l)), Node::operand(std::move(r)), typename Node::flipped{});
     }
+};
 
+template <typename Operator>
+struct ZJType {
+    template <typename T1, typename T2>
+    using Proxy = typename BinaryNode<Operator, T1, T2>::type;
 
+    template <typename T1, typename T2>
+    static VectorWrapper<Proxy<T1, T2>> calculate(T1&& l, T2&& r) {
+        return VectorWrapper<Proxy<T1, T2>>(BinaryNode<Operator, T1, T2>::make(std::forward<T1>(l), std::forward<T2>(r)));
+    }
 };
 
-template <typename T1, typename T2, typename Operator = std::plus<typename ReturnType<T1, T2>::type>>
-auto operator+(const T1& l, const T2& r) -> decltype(ZJType<Operator>::calculate(l, r)) {
-    return ZJType<Operator>::calculate(l, r);
+template <typename T>
+using Decay = typename std::decay<T>::type;
+
+template <typename T1, typename T2, typename Operator = std::plus<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto operator+(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = std::minus<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto operator-(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = std::multiplies<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto operator*(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = std::divides<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto operator/(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+// Comparisons, logic, min and max between arrays, expressions and scalars,
+// with the operands promoted as for x + y
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::less<>>>
+auto operator<(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::less_equal<>>>
+auto operator<=(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::greater<>>>
+auto operator>(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::greater_equal<>>>
+auto operator>=(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::equal_to<>>>
+auto operator==(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = comparison<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::not_equal_to<>>>
+auto operator!=(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+// elementwise, so both operands are always evaluated
+template <typename T1, typename T2, typename Operator = logical<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::bit_and<>>>
+auto operator&&(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
+}
+
+template <typename T1, typename T2, typename Operator = logical<typename ReturnType<Decay<T1>, Decay<T2>>::type, std::bit_or<>>>
+auto operator||(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
 }
 
-template <typename T1, typename T2, typename Operator = std::minus<typename ReturnType<T1, T2>::type>>
-auto operator-(const T1& l, const T2& r) -> decltype(ZJType<Operator>::calculate(l, r)) {
-    return ZJType<Operator>::calculate(l, r);
+template <typename T1, typename T2, typename Operator = minimum<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto min(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
 }
 
-template <typename T1, typename T2, typename Operator = std::multiplies<typename ReturnType<T1, T2>::type>>
-auto operator*(const T1& l, const T2& r) -> decltype(ZJType<Operator>::calculate(l, r)) {
-    return ZJType<Operator>::calculate(l, r);
+template <typename T1, typename T2, typename Operator = maximum<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto max(T1&& l, T2&& r) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(l), std::forward<T2>(r));
 }
 
-template <typename T1, typename T2, typename Operator = std::divides<typename ReturnType<T1, T2>::type>>
-auto operator/(const T1& l, const T2& r) -> decltype(ZJType<Operator>::calculate(l, r)) {
-    return ZJType<Operator>::calculate(l, r);
+// x limited to [lo, hi], as std::clamp: min(max(x, lo), hi)
+template <typename T1, typename T2, typename T3>
+auto clamp(T1&& x, T2&& lo, T3&& hi) -> decltype(min(max(std::forward<T1>(x), std::forward<T2>(lo)), std::forward<T3>(hi))) {
+    return min(max(std::forward<T1>(x), std::forward<T2>(lo)), std::forward<T3>(hi));
+}
+
+template <typename M, typename T1, typename T2>
+VectorWrapper<WhereProxy<LeafOf<M>, LeafOf<T1>, LeafOf<T2>>> where(M&& m, T1&& a, T2&& b) {
+    using Proxy = WhereProxy<LeafOf<M>, LeafOf<T1>, LeafOf<T2>>;
+    return VectorWrapper<Proxy>(Proxy(leaf_of<M>::make(std::forward<M>(m)), leaf_of<T1>::make(std::forward<T1>(a)), leaf_of<T2>::make(std::forward<T2>(b))));
+}
+
+// pow(x, y) for arrays, expressions and scalars, typed like x + y
+template <typename T1, typename T2, typename Operator = power<typename ReturnType<Decay<T1>, Decay<T2>>::type>>
+auto pow(T1&& x, T2&& y) -> decltype(ZJType<Operator>::calculate(std::forward<T1>(x), std::forward<T2>(y))) {
+    return ZJType<Operator>::calculate(std::forward<T1>(x), std::forward<T2>(y));
+}
+
+// sqrt(x), exp(x), ... are x.sqrt(), x.exp(), ...
+template <typename T>
+auto sqrt(T&& x) -> decltype(std::forward<T>(x).sqrt()) { return std::forward<T>(x).sqrt(); }
+
+template <typename T>
+auto abs(T&& x) -> decltype(std::forward<T>(x).abs()) { return std::forward<T>(x).abs(); }
+
+template <typename T>
+auto exp(T&& x) -> decltype(std::forward<T>(x).exp()) { return std::forward<T>(x).exp(); }
+
+template <typename T>
+auto log(T&& x) -> decltype(std::forward<T>(x).log()) { return std::forward<T>(x).log(); }
+
+template <typename T>
+auto sin(T&& x) -> decltype(std::forward<T>(x).sin()) { return std::forward<T>(x).sin(); }
+
+template <typename T>
+auto cos(T&& x) -> decltype(std::forward<T>(x).cos()) { return std::forward<T>(x).cos(); }
+
+template <typename T>
+auto tanh(T&& x) -> decltype(std::forward<T>(x).tanh()) { return std::forward<T>(x).tanh(); }
+
+template <typename T>
+auto floor(T&& x) -> decltype(std::forward<T>(x).floor()) { return std::forward<T>(x).floor(); }
+
+template <typename T>
+auto ceil(T&& x) -> decltype(std::forward<T>(x).ceil()) { return std::forward<T>(x).ceil(); }
+
+template <typename V>
+valarray<typename V::value_type, epl::pool_allocator> eval(const VectorWrapper<V>& x) {
+    return x.eval();
+}
+
+// shift(x, k)[i] is x[i + k], past the ends as the Boundary policy says
+// (zero by default); cshift(x, k) wraps around. Both are lazy, like any other operand.
+template <typename T, typename Boundary = zero_boundary>
+VectorWrapper<ShiftProxy<LeafOf<T>, Boundary>> shift(T&& x, int64_t k, Boundary = Boundary{}) {
+    using Proxy = ShiftProxy<LeafOf<T>, Boundary>;
+    return VectorWrapper<Proxy>(Proxy(leaf_of<T>::make(std::forward<T>(x)), k));
+}
+
+template <typename T>
+VectorWrapper<ShiftProxy<LeafOf<T>, periodic_boundary>> cshift(T&& x, int64_t k) {
+    return shift(std::forward<T>(x), k, periodic_boundary{});
+}
+
+// reduce(x, stats::sum, stats::argmax, ...) computes each element of x once and
+// returns a tuple of the statistics asked for, in the order given
+template <typename T, typename... Stats>
+FusedReduction::Result<LeafOf<T>, Stats...> reduce(T&& x, Stats... s) {
+    const auto& leaf = leaf_of<T>::make(std::forward<T>(x));
+    return FusedReduction::reduce(leaf, leaf.size(), s...);
+}
+
+// the sum of a[i] * b[i], and the Euclidean norm of x
+template <typename T1, typename T2>
+auto dot(T1&& a, T2&& b) -> typename std::tuple_element<0, decltype(reduce(std::forward<T1>(a) * std::forward<T2>(b), stats::sum))>::type {
+    return std::get<0>(reduce(std::forward<T1>(a) * std::forward<T2>(b), stats::sum));
+}
+
+template <typename T>
+FloatingType<typename Access<LeafOf<T>>::element_type> norm2(T&& x) {
+    using F = FloatingType<typename Access<LeafOf<T>>::element_type>;
+    return std::sqrt(F(std::get<0>(reduce(std::forward<T>(x), stats::detail::floating_sumsq_t{}))));
+}
+
+// tie(a, b) = pack(e, f) assigns e to a and f to b in one sweep over their
+// inputs (see FusedEvaluator), as if both were evaluated before either output is
+// written; each output gets the prefix operator= would write. Should an
+// expression read another's output, or its own at other positions, every
+// expression is evaluated into a temporary first. As with operator=, outputs
+// that are views are not checked.
+template <typename... E>
+struct Pack {
+    std::tuple<ChooseRef<E>...> exprs;
+
+    explicit Pack(ChooseRef<E>... e) : exprs(std::move(e)...) {}
+};
+
+template <typename... T>
+Pack<LeafOf<T>...> pack(T&&... x) {
+    return Pack<LeafOf<T>...>(leaf_of<T>::make(std::forward<T>(x))...);
+}
+
+// outputs are held by reference, or by value when they are temporary views
+template <typename... Outputs>
+class Tie {
+private:
+    std::tuple<Outputs...> outputs;
+
+    template <typename V>
+    static auto destination(VectorWrapper<V>& out) -> decltype(Store<V>::destination(out)) { return Store<V>::destination(out); }
+
+    template <typename V>
+    static typename Store<V>::element_type element_of(const VectorWrapper<V>&);
+
+    template <size_t I, size_t J, typename V, typename E>
+    static bool reads(VectorWrapper<V>& out, const E& expr, std::true_type) {
+        std::pair<const void*, const void*> extent = Store<V>::extent(out);
+        return Access<E>::aliases(expr, extent.first, extent.second, I != J);
+    }
+
+    template <size_t I, size_t J, typename V, typename E>
+    static bool reads(VectorWrapper<V>&, const E&, std::false_type) {
+        return false;
+    }
+
+    // whether any expression reads output I where the sweep would disturb it
+    template <size_t I, typename V, typename... E, size_t... J>
+    static bool aliased(VectorWrapper<V>& out, const std::tuple<E...>& exprs, std::index_sequence<J...>) {
+        bool any = false;
+        int each[] = { (any = any || reads<I, J>(out, std::get<J>(exprs), std::integral_constant<bool, Store<V>::owner>{}), 0)... };
+        (void) each;
+        return any;
+    }
+
+    template <typename... E, size_t... I>
+    void assign(const std::tuple<E...>& exprs, std::index_sequence<I...> seq) {
+        uint64_t sizes[] = { std::min<uint64_t>(std::get<I>(outputs).size(), std::get<I>(exprs).size())... };
+        bool any = false;
+        int check[] = { (any = any || aliased<I>(std::get<I>(outputs), exprs, seq), 0)... };
+        (void) check;
+
+        if (any) {
+            std::tuple<vector<decltype(element_of(std::get<I>(outputs)))>...> temps(
+                vector<decltype(element_of(std::get<I>(outputs)))>(sizes[I], epl::uninitialized)...);
+            int materialized[] = { (epl::instrumentation::materialized<decltype(element_of(std::get<I>(outputs)))>(), 0)... };
+            (void) materialized;
+            FusedEvaluator::assign(std::make_tuple(std::get<I>(temps).data()...), exprs, sizes);
+            FusedEvaluator::assign(std::make_tuple(destination(std::get<I>(outputs))...), temps, sizes);
+        } else {
+            FusedEvaluator::assign(std::make_tuple(destination(std::get<I>(outputs))...), exprs, sizes);
+        }
+    }
+
+public:
+    explicit Tie(Outputs&&... out) : outputs(std::forward<Outputs>(out)...) {}
+
+    template <typename... E>
+    Tie& operator=(const Pack<E...>& p) {
+        static_assert(sizeof...(E) == sizeof...(Outputs), "tie and pack need as many outputs as expressions");
+        assign(p.exprs, std::index_sequence_for<E...>{});
+        return *this;
+    }
+};
+
+template <typename... Outputs>
+Tie<Outputs...> tie(Outputs&&... out) {
+    return Tie<Outputs...>(std::forward<Outputs>(out)...);
 }
 
 template <typename T>
@@ -0,0 +1,1330 @@
+/*
+ * Valarray_PhaseC_unittests.cpp
+ * Evaluation engine and extensions
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <complex>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+
+#include "InstanceCounter.h"
+#include "Valarray.h"
+
+#include "gtest/gtest.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::complex;
+
+using namespace epl;
+
+/*********************************************************************/
+// Phase C Tests
+/*********************************************************************/
+
+#if defined(PHASE_C0_0) | defined(PHASE_C)
+TEST(PhaseC, PacketEvaluation) {
+    // sizes around the packet width exercise both the packet loop and the scalar tail
+    for (int n : { 1, 3, 7, 8, 17, 33, 1000 }) {
+        valarray<double> a(n), b(n), c(n), d(n);
+        valarray<float> f(n), g(n);
+        valarray<int> x(n), y(n);
+        for (int i = 0; i < n; ++i) {
+            a[i] = i * 0.5;
+            b[i] = i + 1.0;
+            f[i] = i * 0.25f;
+            x[i] = i;
+        }
+
+        c = a * b + a / b - 2.0;
+        d = -(a * a).sqrt();
+        g = f * f + 1.0f;
+        y = (x + 3) * x - x / 2;
+        for (int i = 0; i < n; ++i) {
+            EXPECT_DOUBLE_EQ(a[i] * b[i] + a[i] / b[i] - 2.0, c[i]);
+            EXPECT_DOUBLE_EQ(-a[i], d[i]);
+            EXPECT_FLOAT_EQ(f[i] * f[i] + 1.0f, g[i]);
+            EXPECT_EQ((i + 3) * i - i / 2, y[i]);
+        }
+
+        // mixed element types go through the converting scalar path
+        c = x + a;
+        for (int i = 0; i < n; ++i) {
+            EXPECT_DOUBLE_EQ(i + a[i], c[i]);
+        }
+
+        y = 7;
+        for (int i = 0; i < n; ++i) {
+            EXPECT_EQ(7, y[i]);
+        }
+    }
+}
+#endif
+
+#if defined(PHASE_C0_1) | defined(PHASE_C)
+TEST(PhaseC, ParallelAssignment) {
+    unsigned threads = epl::num_threads();
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_num_threads(4);
+    epl::set_parallel_threshold(100);
+
+    const int n = 100003;
+    valarray<double> a(n), b(n), c(n);
+    valarray<int> x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = i * 0.5;
+        b[i] = n - i;
+        x[i] = i;
+    }
+
+    c = a * b - a / b;
+    y = x * 2 + 1;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ(a[i] * b[i] - a[i] / b[i], c[i]);
+        EXPECT_EQ(i * 2 + 1, y[i]);
+    }
+
+    // below the threshold the calling thread evaluates alone
+    valarray<int> z(50);
+    z = 1 + z;
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_EQ(1, z[i]);
+    }
+
+    epl::set_parallel_threshold(threshold);
+    epl::set_num_threads(threads);
+}
+#endif
+
+#if defined(PHASE_C0_2) | defined(PHASE_C)
+TEST(PhaseC, Reduction) {
+    unsigned threads = epl::num_threads();
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_parallel_threshold(1000);
+
+    const int n = 250007;
+    valarray<double> a(n), b(n);
+    valarray<int> x(n);
+    long double exact = 0;
+    for (int i = 0; i < n; ++i) {
+        a[i] = 1.0 / (i + 1);
+        b[i] = (i % 7) * 1e-3;
+        x[i] = i % 100;
+        exact += a[i] + b[i];
+    }
+
+    epl::set_num_threads(1);
+    double serial = (a + b).sum();
+    int isum = x.sum();
+    epl::set_num_threads(3);
+    double three = (a + b).sum();
+    epl::set_num_threads(4);
+    double four = (a + b).sum();
+
+    // deterministic mode: identical bits whatever the thread count
+    EXPECT_EQ(serial, three);
+    EXPECT_EQ(serial, four);
+    EXPECT_NEAR((double) exact, serial, 1e-9);
+    EXPECT_EQ(isum, x.accumulate(std::plus<int>()));
+    EXPECT_EQ(n / 100 * 4950 + (n % 100) * (n % 100 - 1) / 2, isum);
+
+    epl::set_reduction_mode(epl::reduction_mode::fast);
+    EXPECT_NEAR((double) exact, (a + b).sum(), 1e-9);
+    EXPECT_EQ(isum, x.sum());
+    epl::set_reduction_mode(epl::reduction_mode::deterministic);
+
+    valarray<double> small{ 1.5, 2.0, 4.0 };
+    EXPECT_EQ(12.0, small.accumulate(std::multiplies<double>()));
+
+    epl::set_parallel_threshold(threshold);
+    epl::set_num_threads(threads);
+}
+#endif
+
+#if defined(PHASE_C0_3) | defined(PHASE_C)
+TEST(PhaseC, SizedConstruction) {
+    const int n = 1001;
+    valarray<int> x(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = i;
+    }
+
+    int cnt = InstanceCounter::counter;
+    valarray<double> y = (x * 4).sqrt();
+    valarray<complex<double>> z = y + complex<double>(0, 1);
+    EXPECT_EQ(cnt + 2, InstanceCounter::counter);
+
+    EXPECT_EQ(n, y.size());
+    EXPECT_EQ(n, z.size());
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ(std::sqrt(i * 4.0), y[i]);
+        EXPECT_EQ(complex<double>(y[i], 1), z[i]);
+    }
+}
+#endif
+
+#if defined(PHASE_C0_4) | defined(PHASE_C)
+valarray<double> iota(int n, double start) {
+    valarray<double> result(n);
+    for (int i = 0; i < n; ++i) {
+        result[i] = start + i;
+    }
+    return result;
+}
+
+TEST(PhaseC, MoveSemantics) {
+    valarray<double> a = iota(10, 0);
+    const double* buffer = a.data();
+
+    valarray<double> b = std::move(a);
+    EXPECT_EQ(buffer, b.data());
+    EXPECT_EQ(10, b.size());
+
+    valarray<double> c(10);
+    c = std::move(b);
+    EXPECT_EQ(buffer, c.data());
+
+    // expressions take ownership of temporaries, so they outlive the full expression
+    auto sum = iota(10, 1) + c;
+    auto root = (iota(10, 0) * 4.0).sqrt();
+    auto neg = -iota(10, 2);
+    valarray<double> d = sum * root + neg;
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_DOUBLE_EQ((1.0 + i + i) * std::sqrt(4.0 * i) - (2.0 + i), d[i]);
+    }
+
+    // a moved-from valarray can still grow
+    b.push_back(1.5);
+    EXPECT_EQ(1, b.size());
+    EXPECT_EQ(1.5, b[0]);
+}
+#endif
+
+#if defined(PHASE_C0_5) | defined(PHASE_C)
+TEST(PhaseC, CompoundAssignment) {
+    const int n = 37;
+    valarray<double> x(n), v(n);
+    valarray<int> k(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = i;
+        v[i] = 2.0 * i;
+        k[i] = i;
+    }
+
+    int cnt = InstanceCounter::counter;
+    x += 0.5 * v;       // x = 2i
+    x += x * 2;         // aliases the destination: x = 6i
+    x -= 1;
+    x *= v + 1.0;
+    x /= 2.0;
+    k *= 3;
+    k -= k / 2;
+    EXPECT_EQ(cnt, InstanceCounter::counter);
+
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ((6.0 * i - 1) * (2.0 * i + 1) / 2.0, x[i]);
+        EXPECT_EQ(3 * i - (3 * i) / 2, k[i]);
+    }
+
+    // only the overlapping prefix is updated
+    valarray<int> shorter(10);
+    k += shorter + 1;
+    EXPECT_EQ(3 * 9 - (3 * 9) / 2 + 1, k[9]);
+    EXPECT_EQ(3 * 10 - (3 * 10) / 2, k[10]);
+}
+#endif
+
+#if defined(PHASE_C0_6) | defined(PHASE_C)
+TEST(PhaseC, AllocatorPolicy) {
+    const int n = 1000;
+    valarray<double, epl::aligned_allocator<64>> a(n);
+    valarray<double, epl::huge_page_allocator> big(600000); // > 2 MiB
+    valarray<double> b(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = i;
+        b[i] = 2 * i;
+    }
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(a.data()) % 64);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(big.data()) % (2 << 20));
+
+    // expressions mix policies freely; the destination's policy owns the result
+    valarray<double, epl::aligned_allocator<64>> c = a + b;
+    big = a * b;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(3.0 * i, c[i]);
+        EXPECT_EQ(2.0 * i * i, big[i]);
+    }
+    EXPECT_EQ(0.0, big[n]);
+
+    for (int i = 0; i < 100; ++i) {
+        a.push_back(i);
+        a.push_front(i);
+    }
+    EXPECT_EQ(n + 200, a.size());
+    valarray<int> x{ 1, 2, 3 };
+    valarray<double, epl::huge_page_allocator> y = x;
+    EXPECT_EQ(3.0, y[2]);
+}
+#endif
+
+#if defined(PHASE_C0_7) | defined(PHASE_C)
+TEST(PhaseC, PoolAllocator) {
+    using scratch = valarray<double, epl::pool_allocator>;
+    const int n = 1000;
+    valarray<double> x(n), v(n);
+    for (int i = 0; i < n; ++i) {
+        v[i] = i;
+    }
+
+    epl::pool_scope scope;
+    uint64_t misses = 0;
+    for (int step = 0; step < 10; ++step) {
+        scratch dx = v * 0.5;
+        scratch half(n);
+        half = dx * dx;
+        x += dx + half;
+        if (step == 0) {
+            misses = scope.pool().misses();
+        }
+    }
+    // every buffer after the first iteration came out of the pool
+    EXPECT_EQ(misses, scope.pool().misses());
+    EXPECT_EQ(18u, scope.pool().hits());
+
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ(10 * (0.5 * i + 0.25 * i * i), x[i]);
+    }
+}
+#endif
+
+#if defined(PHASE_C0_8) | defined(PHASE_C)
+TEST(PhaseC, TrivialRelocation) {
+    valarray<int> x;
+    for (int i = 0; i < 100000; ++i) {
+        x.push_back(i);
+        if (i % 1000 == 0) {
+            x.push_front(-i);
+        }
+    }
+    EXPECT_EQ(100100, x.size());
+    EXPECT_EQ(-99000, x[0]);
+    EXPECT_EQ(0, x[99]);
+    EXPECT_EQ(99999, x[100099]);
+
+    valarray<int> y = x;
+    EXPECT_EQ(x.size(), y.size());
+    EXPECT_EQ(x[5000], y[5000]);
+
+    // element types with real constructors still take the element-wise path
+    epl::vector<string> names{ "a", "b" };
+    for (int i = 0; i < 20; ++i) {
+        names.push_back(std::to_string(i));
+        names.push_front(std::to_string(-i));
+    }
+    epl::vector<string> copy(names);
+    EXPECT_EQ(42, copy.size());
+    EXPECT_EQ("-19", copy[0]);
+    EXPECT_EQ("19", copy[41]);
+
+    valarray<double> scratch(1000, epl::uninitialized);
+    scratch = 1.5;
+    EXPECT_EQ(1000, scratch.size());
+    EXPECT_EQ(1.5, scratch[999]);
+}
+#endif
+
+#if defined(PHASE_C0_9) | defined(PHASE_C)
+TEST(PhaseC, Instrumentation) {
+    valarray<double> a(1000), b(1000), c(1000), d(1000);
+    for (int i = 0; i < 1000; ++i) {
+        b[i] = i;
+        c[i] = 2;
+        d[i] = 1;
+    }
+
+    // the hot path: an expression assigned into existing storage
+    snapshot before = snapshot::of<double>();
+    a = b * c + d;
+    snapshot delta = snapshot::of<double>() - before;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(0u, delta.allocations);
+        EXPECT_EQ(0u, delta.materializations);
+        EXPECT_EQ(0u, delta.copies);
+    }
+    EXPECT_EQ(999.0 * 2 + 1, a[999]);
+
+    // fills and compound assignments write existing storage too
+    before = snapshot::of<double>();
+    d = 1.0;
+    a += b * c;
+    delta = snapshot::of<double>() - before;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(0u, delta.materializations);
+    }
+    EXPECT_EQ(2 * (999.0 * 2) + 1, a[999]);
+
+    before = snapshot::of<double>();
+    {
+        valarray<double> e = a + b;
+        valarray<double> f = e;
+        valarray<double> g = std::move(f);
+        delta = snapshot::of<double>() - before;
+        if (instrumentation_enabled) {
+            EXPECT_EQ(2u, delta.allocations);
+            EXPECT_EQ(2, delta.live_buffers);
+            EXPECT_EQ(1000u * 2 * sizeof(double), delta.bytes_allocated);
+            EXPECT_EQ(1u, delta.copies);
+            EXPECT_EQ(1u, delta.moves);
+            EXPECT_EQ(1u, delta.materializations);
+        }
+    }
+    delta = snapshot::of<double>() - before;
+    EXPECT_EQ(0, delta.live_buffers);
+    EXPECT_EQ(delta.allocations, delta.deallocations);
+
+    // growth at either end counts as reallocation, in place or not
+    before = snapshot::of<int64_t>();
+    epl::vector<int64_t> grow;
+    for (int i = 0; i < 100; ++i) {
+        grow.push_back(i);
+        grow.push_front(-i);
+    }
+    delta = snapshot::of<int64_t>() - before;
+    if (instrumentation_enabled) {
+        EXPECT_LT(0u, delta.reallocations);
+        EXPECT_EQ(1, delta.live_buffers);
+    }
+
+    // counters stay exact when vectors are created on many threads at once
+    before = snapshot::of<short>();
+    snapshot all_before = snapshot::all();
+    std::vector<std::future<void>> jobs;
+    for (int t = 0; t < 4; ++t) {
+        jobs.push_back(std::async(std::launch::async, [] {
+            for (int k = 0; k < 1000; ++k) {
+                epl::vector<short> v(10);
+                v.push_back(1);
+            }
+        }));
+    }
+    for (auto& job : jobs) {
+        job.get();
+    }
+    delta = snapshot::of<short>() - before;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(4000u, delta.allocations); // grown in place by realloc
+        EXPECT_EQ(4000u, delta.reallocations);
+        EXPECT_EQ(0, delta.live_buffers);
+        EXPECT_LE(4000u, (snapshot::all() - all_before).allocations);
+    }
+}
+#endif
+
+#if defined(PHASE_C0_10) | defined(PHASE_C)
+TEST(PhaseC, SliceViews) {
+    valarray<double> a(12);
+    valarray<double> b{ 0.0, 1.0, 2.0, 3.0 };
+
+    // written in one pass, straight into every third element
+    snapshot before = snapshot::all();
+    a[slice(0, 4, 3)] = b * 2;
+    snapshot delta = snapshot::all() - before;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(0u, delta.allocations);
+    }
+    for (int i = 0; i < 12; ++i) {
+        EXPECT_EQ(i % 3 == 0 ? 2.0 * (i / 3) : 0.0, a[i]);
+    }
+
+    a[slice(0, 4, 3)] += 1;
+    EXPECT_EQ(7.0, a[9]);
+    EXPECT_EQ(0.0, a[10]);
+
+    // views are ordinary lazy operands
+    valarray<double> c = a[slice(0, 4, 3)] + b;
+    EXPECT_EQ(4, c.size());
+    EXPECT_EQ(10.0, c[3]);
+    EXPECT_EQ(16.0, a[slice(0, 4, 3)].sum());
+    EXPECT_EQ(6.0, (b * 2)[slice(1, 2, 1)].sum());
+
+    const valarray<double>& ca = a;
+    EXPECT_EQ(3.0, ca[slice(3, 2, 1)][0]);
+
+    a[slice(1, 11, 1)] = 5.0;
+    EXPECT_EQ(1.0, a[0]);
+    EXPECT_EQ(5.0, a[1]);
+    EXPECT_EQ(5.0, a[11]);
+
+    // matrix stored flat, 3 rows of 4: column 2 and the lower right 2x2 block
+    valarray<int> m(12);
+    for (int i = 0; i < 12; ++i) {
+        m[i] = i;
+    }
+    EXPECT_EQ(2 + 6 + 10, m[slice(2, 3, 4)].sum());
+    EXPECT_EQ(6 + 7 + 10 + 11, m[gslice(6, { 2, 2 }, { 4, 1 })].sum());
+    m[gslice(6, { 2, 2 }, { 4, 1 })] = m[slice(0, 4, 1)] * -1;
+    EXPECT_EQ(0, m[6]);
+    EXPECT_EQ(-1, m[7]);
+    EXPECT_EQ(-2, m[10]);
+    EXPECT_EQ(-3, m[11]);
+    EXPECT_EQ(9, m[9]);
+
+    // long strided views exercise gathered and scattered packets on both sides
+    valarray<float> x(3000), y(1000);
+    for (int i = 0; i < 1000; ++i) {
+        y[i] = i;
+    }
+    x[slice(1, 1000, 3)] = y * 2 + y[slice(0, 1000, 1)];
+    x[gslice(2, { 10, 100 }, { 300, 3 })] = y[slice(0, 1000, 1)] - 1;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(0.0f, x[3 * i]);
+        EXPECT_EQ(3.0f * i, x[3 * i + 1]);
+        EXPECT_EQ(i - 1.0f, x[3 * i + 2]);
+    }
+
+    EXPECT_THROW(a[slice(0, 5, 3)], std::out_of_range);
+    EXPECT_THROW(a[gslice(0, { 2, 2 }, { 6, 6 })], std::out_of_range);
+}
+#endif
+
+#if defined(PHASE_C0_11) | defined(PHASE_C)
+TEST(PhaseC, IndirectAndMaskViews) {
+    valarray<double> table(100);
+    for (int i = 0; i < 100; ++i) {
+        table[i] = i * 0.5;
+    }
+
+    // out[i] = table[idx[i]], composed with the rest of the expression
+    const int n = 5000;
+    valarray<int> idx(n);
+    for (int i = 0; i < n; ++i) {
+        idx[i] = (i * 37) % 100;
+    }
+    valarray<double> out(n);
+    out = table[indirect(idx)] * 2 + 1;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ((i * 37) % 100 + 1.0, out[i]);
+    }
+
+    // scatter-accumulate: repeated indices each contribute
+    valarray<int> bins(n);
+    for (int i = 0; i < n; ++i) {
+        bins[i] = i % 7;
+    }
+    valarray<int> histogram(7);
+    histogram[indirect(bins)] += 1;
+    for (int b = 0; b < 7; ++b) {
+        EXPECT_EQ(n / 7 + (b < n % 7 ? 1 : 0), histogram[b]);
+    }
+
+    // also when the expression is large enough to be split between threads
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_num_threads(4);
+    epl::set_parallel_threshold(100);
+    valarray<double> weights(n);
+    for (int i = 0; i < n; ++i) {
+        weights[i] = 0.5;
+    }
+    valarray<double> sums(7);
+    sums[indirect(bins)] += weights;
+    EXPECT_EQ(0.5 * histogram[3], sums[3]);
+
+    // strictly increasing indices are written in parallel, a packet at a time
+    valarray<int> even(n / 2);
+    for (int i = 0; i < n / 2; ++i) {
+        even[i] = 2 * i;
+    }
+    valarray<double> wide(n);
+    wide[indirect(even)] = out[slice(0, n / 2, 1)] - 1;
+    EXPECT_EQ(out[1] - 1, wide[2]);
+    EXPECT_EQ(0.0, wide[3]);
+    EXPECT_EQ(out[n / 2 - 1] - 1, wide[n - 2]);
+    epl::set_parallel_threshold(threshold);
+    epl::set_num_threads(epl::thread_pool::default_concurrency());
+
+    // masks pick the nonzero positions of any valarray
+    valarray<int> flags(10);
+    for (int i = 0; i < 10; ++i) {
+        flags[i] = i % 3 == 0;
+    }
+    valarray<double> m(10);
+    m[mask(flags)] = 4.0;
+    EXPECT_EQ(4.0, m[9]);
+    EXPECT_EQ(0.0, m[8]);
+    EXPECT_EQ(16.0, m[mask(flags)].sum());
+    EXPECT_EQ(4, m[mask(flags)].size());
+
+    valarray<int> bad{ 0, 100 };
+    EXPECT_THROW(table[indirect(bad)], std::out_of_range);
+    bad[1] = -1;
+    EXPECT_THROW(indirect(bad), std::out_of_range);
+}
+#endif
+
+#if defined(PHASE_C0_12) | defined(PHASE_C)
+TEST(PhaseC, ShiftStencils) {
+    valarray<double> x{ 1.0, 2.0, 3.0, 4.0, 5.0 };
+    valarray<double> y(5);
+
+    y = shift(x, 1);
+    EXPECT_EQ(2.0, y[0]);
+    EXPECT_EQ(0.0, y[4]);
+    y = shift(x, -2);
+    EXPECT_EQ(0.0, y[1]);
+    EXPECT_EQ(1.0, y[2]);
+    y = shift(x, 1, clamp_boundary{});
+    EXPECT_EQ(5.0, y[4]);
+    y = cshift(x, -1);
+    EXPECT_EQ(5.0, y[0]);
+    EXPECT_EQ(4.0, y[4]);
+    y = cshift(x, 12);
+    EXPECT_EQ(3.0, y[0]);
+    EXPECT_EQ(15.0, cshift(x, 3).sum());
+    EXPECT_EQ(18.0, shift(x * 2, 3).sum());
+
+    // a heat equation step: long enough for packets, parallel chunks and
+    // the boundary split on both sides, and evaluated in place
+    const int n = 10007;
+    const double k = 0.25;
+    valarray<double> u(n), expected(n);
+    for (int i = 0; i < n; ++i) {
+        u[i] = (i * 7919) % 101;
+    }
+    for (int i = 0; i < n; ++i) {
+        double left = i > 0 ? u[i - 1] : u[0];
+        double right = i < n - 1 ? u[i + 1] : u[n - 1];
+        expected[i] = u[i] + k * (right - 2 * u[i] + left);
+    }
+
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_num_threads(4);
+    epl::set_parallel_threshold(1000);
+    valarray<double> u_new(n);
+    snapshot before = snapshot::all();
+    u_new = u + k * (shift(u, 1, clamp_boundary{}) - 2 * u + shift(u, -1, clamp_boundary{}));
+    EXPECT_EQ(0u, (snapshot::all() - before).allocations);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ(expected[i], u_new[i]);
+    }
+
+    // u reads its neighbours, so updating it in place goes through a temporary
+    u += k * (shift(u, 1, clamp_boundary{}) - 2 * u + shift(u, -1, clamp_boundary{}));
+    epl::set_parallel_threshold(threshold);
+    epl::set_num_threads(epl::thread_pool::default_concurrency());
+    for (int i = 0; i < n; ++i) {
+        EXPECT_DOUBLE_EQ(expected[i], u[i]);
+    }
+
+    valarray<int> v(100);
+    for (int i = 0; i < 100; ++i) {
+        v[i] = i;
+    }
+    EXPECT_EQ(4950 - 99 - 98 - 97, shift(v, -3).sum());
+    v = cshift(v, 1);
+    EXPECT_EQ(1, v[0]);
+    EXPECT_EQ(0, v[99]);
+}
+#endif
+
+#if defined(PHASE_C0_13) | defined(PHASE_C)
+TEST(PhaseC, EvalMaterialization) {
+    const int n = 1000;
+    valarray<double> v1(n);
+    for (int i = 0; i < n; ++i) {
+        v1[i] = i + 1;
+    }
+
+    valarray<double> lazy = v1 * ((-((v1 * 4).sqrt())) + v1) / v1;
+
+    // the square root is computed once and shared by both expressions
+    snapshot before = snapshot::of<double>();
+    auto root4 = (v1 * 4).sqrt().eval();
+    valarray<double> reused = v1 * (-root4 + v1) / v1;
+    valarray<double> twice = root4 + root4;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(3u, (snapshot::of<double>() - before).materializations);
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(lazy[i], reused[i]);
+        EXPECT_EQ(2 * std::sqrt(4.0 * (i + 1)), twice[i]);
+    }
+
+    // in place, inside an expression, and from the scratch pool when one is active
+    epl::pool_scope scope;
+    for (int step = 0; step < 5; ++step) {
+        reused = v1 * (-eval((v1 * 4).sqrt()) + v1) / v1;
+    }
+    EXPECT_EQ(4u, scope.pool().hits());
+    EXPECT_EQ(lazy[n - 1], reused[n - 1]);
+
+    // elements keep the expression's value_type, as the lazy form would
+    valarray<int> k{ 1, 4, 9, 10 };
+    auto roots = k.sqrt().eval();
+    EXPECT_EQ(3, roots[2]);
+    EXPECT_EQ(3, roots[3]);
+}
+#endif
+
+#if defined(PHASE_C0_14) | defined(PHASE_C)
+TEST(PhaseC, CostModel) {
+    valarray<double> a(10), b(10);
+    auto simple = a + b;
+    auto heavy = (a * 4 + b).sqrt() / a;
+    using Simple = decltype(simple);
+    using Heavy = decltype(heavy);
+    using SimpleNode = BinaryProxy<vector<double>, vector<double>, std::plus<double>>;
+
+    static_assert(std::is_base_of<SimpleNode, Simple>::value, "a + b is a BinaryProxy of two leaves");
+    static_assert(Cost<SimpleNode>::depth == 2u, "depth of a + b");
+    static_assert(Cost<SimpleNode>::leaves == 2u, "leaves of a + b");
+    static_assert(Cost<SimpleNode>::flops == 1u, "flops of a + b");
+    static_assert(Cost<SimpleNode>::bytes == 16u, "bytes of a + b");
+
+#ifdef EPL_FMA
+    // a * 4 + b is one fused node
+    using Sum = FmaProxy<vector<double>, Scalar<int>, vector<double>, multiply_add<double>>;
+    const uint64_t sum_depth = 2, sum_flops = 1;
+#else
+    using Sum = BinaryProxy<BinaryProxy<vector<double>, Scalar<int>, std::multiplies<double>>, vector<double>, std::plus<double>>;
+    const uint64_t sum_depth = 3, sum_flops = 2;
+#endif
+    using Root = UnaryProxy<Sum, root<double>>;
+    using Quotient = BinaryProxy<Root, vector<double>, std::divides<double>>;
+    static_assert(std::is_base_of<Quotient, Heavy>::value, "sqrt(a * 4 + b) / a is a quotient of a UnaryProxy");
+    static_assert(Cost<Quotient>::depth == sum_depth + 2, "depth of sqrt(a * 4 + b) / a");
+    static_assert(Cost<Quotient>::leaves == 4u, "leaves of sqrt(a * 4 + b) / a");
+    static_assert(Cost<Quotient>::flops == sum_flops + 8 + 8, "flops of sqrt(a * 4 + b) / a");
+    static_assert(Cost<Quotient>::bytes == 24u, "bytes of sqrt(a * 4 + b) / a");
+
+    // compute-heavy expressions are split between threads at smaller sizes
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_parallel_threshold(1000);
+    EXPECT_FALSE((Strategy<SimpleNode, double>::parallel(999)));
+    EXPECT_TRUE((Strategy<SimpleNode, double>::parallel(1000)));
+    EXPECT_TRUE((Strategy<Quotient, double>::parallel(200)));
+    EXPECT_FALSE((Strategy<vector<int>, int>::parallel(1000)));
+    EXPECT_GT((Strategy<SimpleNode, double>::grain()), (Strategy<Quotient, double>::grain()));
+    EXPECT_EQ(0u, (Strategy<Quotient, double>::grain() % 8));
+    epl::set_parallel_threshold(threshold);
+}
+#endif
+
+#if defined(PHASE_C0_15) | defined(PHASE_C)
+TEST(PhaseC, RandomAccessIterators) {
+    valarray<int> a{ 5, 3, 8, 1, 9, 2 };
+    auto twice = a * 2;
+    using It = decltype(twice.begin());
+    // the parallel algorithms split only ranges whose iterator_category is random access
+    static_assert(std::is_same<std::iterator_traits<It>::iterator_category, std::random_access_iterator_tag>::value, "proxy iterators are tagged random access");
+    static_assert(std::is_same<std::iterator_traits<It>::reference, int>::value, "elements are values, not references");
+#if __cplusplus > 201703L
+    static_assert(std::random_access_iterator<It>, "proxy iterators are random access");
+#endif
+    static_assert(std::is_same<std::iterator_traits<It>::value_type, int>::value, "value_type of a * 2");
+    static_assert(std::is_same<std::iterator_traits<It>::difference_type, int64_t>::value, "difference_type of a * 2");
+
+    It first = twice.begin(), last = twice.end();
+    EXPECT_EQ(6, std::distance(first, last));
+    EXPECT_EQ(6, last - first);
+    EXPECT_EQ(16, first[2]);
+    EXPECT_EQ(18, *(first + 4));
+    EXPECT_EQ(18, *(4 + first));
+    EXPECT_EQ(4, *(last - 1));
+    EXPECT_TRUE(first < last);
+    EXPECT_TRUE(last >= first + 6);
+    It mid = first;
+    mid += 3;
+    EXPECT_EQ(2, *mid);
+    mid -= 1;
+    EXPECT_EQ(16, *mid--);
+    EXPECT_EQ(6, *mid);
+
+    // standard algorithms read the lazy expression without materializing it
+    EXPECT_EQ(56, std::accumulate(first, last, 0));
+    EXPECT_EQ(18, *std::max_element(first, last));
+    std::vector<int> sorted(first, last);
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(2, sorted.front());
+    std::vector<int> shifted(6);
+    std::transform(first, last, (a + 1).begin(), shifted.begin(), std::plus<int>());
+    EXPECT_EQ(16, shifted[0]);
+
+    // lower_bound over a sorted view
+    valarray<double> v{ 1.0, 2.0, 4.0, 8.0, 16.0 };
+    auto roots = v.sqrt();
+    EXPECT_EQ(2, std::lower_bound(roots.begin(), roots.end(), 2.0) - roots.begin());
+
+    // the container's own iterators
+    valarray<int>::iterator it = a.begin();
+    it += 2;
+    EXPECT_EQ(8, *it);
+    EXPECT_EQ(2, it - a.begin());
+    EXPECT_EQ(1, it[1]);
+    EXPECT_TRUE(a.begin() < it && it < a.end());
+    std::sort(a.begin(), a.end());
+    EXPECT_TRUE(std::is_sorted(a.begin(), a.end()));
+    const valarray<int>& ca = a;
+    EXPECT_EQ(9, *(ca.end() - 1));
+    EXPECT_EQ(6, ca.end() - ca.begin());
+}
+#endif
+
+#if defined(PHASE_C0_16) | defined(PHASE_C)
+TEST(PhaseC, SplitComplex) {
+    const int n = 37;
+    complex_valarray<double> a(n), b(n);
+    valarray<complex<double>> x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = complex<double>(i - 3.5, 2.0 * i + 1);
+        b[i] = complex<double>(0.25 * i + 1, 3.0 - i);
+        x[i] = a[i];
+        y[i] = b[i];
+    }
+    EXPECT_EQ(complex<double>(-3.5, 1), a[0]);
+    EXPECT_EQ(-3.5, a[0].real());
+    EXPECT_EQ(1.0, a.imag_data()[0]);
+    EXPECT_EQ(2.0, a.real_data()[n - 1] - a.real_data()[n - 3]);
+
+    // split and interleaved storage give std::complex's results, mixed freely
+    complex_valarray<double> product = a * b;
+    complex_valarray<double> quotient = a / y;
+    valarray<complex<double>> mixed = (x + a) * 0.5 - b;
+    valarray<double> magnitude = a.abs();
+    complex_valarray<double> roots = a.sqrt();
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(x[i] * y[i], product[i]);
+        EXPECT_NEAR(0.0, std::abs(x[i] / y[i] - complex<double>(quotient[i])), 1e-15 * std::abs(x[i] / y[i]));
+        EXPECT_EQ(x[i] - y[i], mixed[i]);
+        EXPECT_NEAR(std::abs(x[i]), magnitude[i], 1e-15 * magnitude[i]);
+        EXPECT_NEAR(0.0, std::abs(std::sqrt(x[i]) - complex<double>(roots[i])), 1e-15 * magnitude[i]);
+    }
+    EXPECT_EQ(complex<double>(0, 2), complex<double>(complex_valarray<double>{ complex<double>(-4, 0) }.sqrt()[0]));
+
+#ifndef EPL_FAST_COMPLEX
+    // special values follow std::complex, not the textbook formulas
+    double inf = std::numeric_limits<double>::infinity();
+    complex_valarray<double> p{ complex<double>(inf, inf), complex<double>(1e300, 1e300), complex<double>(1, 2), complex<double>(0, 0) };
+    complex_valarray<double> q{ complex<double>(1, 0), complex<double>(1e300, -1e300), complex<double>(0, 0), complex<double>(-1, 0) };
+    valarray<complex<double>> pq = p * q, r = p / q;
+    EXPECT_EQ(complex<double>(inf, inf), pq[0]);
+    EXPECT_EQ(complex<double>(p[1]) / complex<double>(q[1]), r[1]);
+    EXPECT_EQ(complex<double>(p[2]) / complex<double>(q[2]), r[2]);
+    EXPECT_EQ(std::abs(complex<double>(1e300, 1e300)), p.abs()[1]);
+
+    // operands near the ends of the exponent range, where __divdc3 scales
+    complex_valarray<double> big{ complex<double>(-0.0, -1e308), complex<double>(1e-300, 0), complex<double>(0, 1e-310) };
+    complex_valarray<double> divisor{ complex<double>(1e308, -1e308), complex<double>(1e300, 1e-200), complex<double>(3, 4) };
+    valarray<complex<double>> extreme = big / divisor, tiny_roots = big.sqrt();
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(complex<double>(big[i]) / complex<double>(divisor[i]), extreme[i]);
+    }
+    EXPECT_EQ(complex<double>(0.5, -0.5), extreme[0]);
+    EXPECT_EQ(std::sqrt(complex<double>(0, 1e-310)), tiny_roots[2]);
+#endif
+
+    // views, shifts and reductions read the planes in place
+    a[slice(0, n / 2, 2)] = b[slice(1, n / 2, 2)] * complex<double>(0, 1);
+    EXPECT_EQ(complex<double>(b[3]) * complex<double>(0, 1), a[2]);
+    complex_valarray<double> s = a + shift(a, 1);
+    EXPECT_EQ(complex<double>(a[4]) + complex<double>(a[5]), s[4]);
+    complex<double> total(0, 0);
+    for (int i = 0; i < n; ++i) { total += y[i]; }
+    EXPECT_NEAR(0.0, std::abs(total - b.sum()), 1e-12);
+    a = b;
+    EXPECT_EQ(b[n - 1], complex<double>(a[n - 1]));
+}
+#endif
+
+#if defined(PHASE_C0_17) | defined(PHASE_C)
+TEST(PhaseC, ElementaryFunctions) {
+    const int n = 1000;
+    const double eps = std::numeric_limits<double>::epsilon();
+    valarray<double> x(n), positive(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = (i - n / 2) * 0.37;
+        positive[i] = std::exp((i - n / 2) * 1.3);
+    }
+
+    // within a few ulps of <cmath> (the same, with EPL_STRICT_LIBM)
+    valarray<double> e = exp(x), l = log(positive), s = sin(x), c = x.cos(), t = tanh(x * 0.1);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(std::exp(x[i]), e[i], 2 * eps * std::exp(x[i]));
+        EXPECT_NEAR(std::log(positive[i]), l[i], 2 * eps * std::abs(std::log(positive[i])));
+        EXPECT_NEAR(std::sin(x[i]), s[i], 4 * eps * std::abs(std::sin(x[i])));
+        EXPECT_NEAR(std::cos(x[i]), c[i], 4 * eps * std::abs(std::cos(x[i])));
+        EXPECT_NEAR(std::tanh(x[i] * 0.1), t[i], 4 * eps * std::abs(std::tanh(x[i] * 0.1)));
+    }
+
+    // exact: abs, floor and ceil, signed zeros included
+    valarray<double> r{ -2.5, -0.5, -0.0, 0.3, 1.0, 4503599627370495.5, 1e300 };
+    valarray<double> down = floor(r), up = r.ceil(), magnitude = abs(r);
+    for (uint64_t i = 0; i < r.size(); ++i) {
+        EXPECT_EQ(std::floor(r[i]), down[i]);
+        EXPECT_EQ(std::ceil(r[i]), up[i]);
+        EXPECT_EQ(std::signbit(std::ceil(r[i])), std::signbit(up[i]));
+        EXPECT_EQ(std::abs(r[i]), magnitude[i]);
+        EXPECT_FALSE(std::signbit(magnitude[i]));
+    }
+
+    // special values are those of <cmath>
+    double inf = std::numeric_limits<double>::infinity();
+    valarray<double> special{ inf, -inf, 1000.0, -1000.0, 0.0, -1.0, -0.0 };
+    valarray<double> es = special.exp(), ls = special.log(), ss = special.sin();
+    for (uint64_t i = 0; i < special.size(); ++i) {
+        double v = special[i];
+        EXPECT_TRUE(std::exp(v) == es[i] || (std::isnan(std::exp(v)) && std::isnan(es[i])));
+        EXPECT_TRUE(std::log(v) == ls[i] || (std::isnan(std::log(v)) && std::isnan(ls[i])));
+        EXPECT_EQ(std::isnan(std::sin(v)), std::isnan(ss[i]));
+    }
+    EXPECT_TRUE(std::signbit(ss[6]));
+
+    // lazy and composable; float arrays stay float
+    valarray<double> round_trip = exp(log(positive) * 0.5) - sqrt(positive);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(0.0, round_trip[i], 4 * eps * std::sqrt(positive[i]));
+    }
+    valarray<float> xf(n);
+    for (int i = 0; i < n; ++i) { xf[i] = float(i + 1) * 0.01f; }
+    valarray<float> pf = pow(xf, 2.5f), sf = (xf * 2.0f).sin();
+    for (int i = 0; i < n; ++i) {
+        float expected = std::pow(xf[i], 2.5f);
+        EXPECT_NEAR(expected, pf[i], std::numeric_limits<float>::epsilon() * expected);
+        EXPECT_NEAR(std::sin(xf[i] * 2.0f), sf[i], 1e-6f);
+    }
+
+    // integers are promoted as <cmath> promotes them; pow is typed like +
+    valarray<int> k{ 1, 2, 3 };
+    static_assert(std::is_same<double, decltype(k.exp())::element_type>::value, "exp of int is double");
+    static_assert(std::is_same<double, decltype(pow(k, 0.5))::value_type>::value, "pow(int, double) is double");
+    EXPECT_EQ(std::exp(2.0), exp(k)[1]);
+    valarray<double> squares = pow(k, 2.0);
+    EXPECT_EQ(9.0, squares[2]);
+    valarray<double> halves = pow(2.0, x[slice(0, 4, 1)] * 0.0 - 1.0);
+    EXPECT_EQ(0.5, halves[3]);
+
+    // ...and stay double through composition, evaluation and reduction
+    static_assert(std::is_same<double, decltype(exp(k))::value_type>::value, "exp of int is a double expression");
+    static_assert(std::is_same<double, decltype(pow(k, 2))::value_type>::value, "pow(int, int) is a double expression");
+    EXPECT_DOUBLE_EQ(2 * std::exp(1.0), (exp(k) * 2)[0]);
+    EXPECT_DOUBLE_EQ(std::exp(1.0), exp(k).eval()[0]);
+    EXPECT_DOUBLE_EQ(std::exp(1.0) + std::exp(2.0) + std::exp(3.0), exp(k).sum());
+    EXPECT_DOUBLE_EQ(std::log(2.0) + std::log(3.0), (log(k) + floor(k)).sum() - 6);
+    EXPECT_DOUBLE_EQ(std::sin(3.0) / 2, (sin(k) / 2)[2]);
+}
+#endif
+
+#if defined(PHASE_C0_18) | defined(PHASE_C)
+TEST(PhaseC, MasksAndWhere) {
+    const int n = 1001;
+    valarray<double> x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = (i % 17) - 8.0;
+        y[i] = (i % 5) - 2.0;
+    }
+
+    // comparisons and logic are lazy; elements convert to bool, and to 1 or 0 when stored
+    auto inside = (x > -3.0) && (x <= 3.0) && !(x == y);
+    valarray<double> stored = inside;
+    for (int i = 0; i < n; ++i) {
+        bool expected = x[i] > -3 && x[i] <= 3 && !(x[i] == y[i]);
+        EXPECT_EQ(expected, bool(inside[i]));
+        EXPECT_EQ(expected ? 1.0 : 0.0, stored[i]);
+        EXPECT_EQ(x[i] < y[i] || x[i] >= 7, bool(((x < y) || (x >= 7))[i]));
+        EXPECT_EQ(x[i] != 0, bool((x != 0.0)[i]));
+    }
+    static_assert(decltype(x < y)::vectorizable == (packet_traits<double>::size > 1), "comparisons of doubles have mask packets");
+    static_assert(decltype(inside)::vectorizable == (packet_traits<double>::size > 1), "logic on masks stays in packets");
+
+    // where, min, max and clamp: branch-free selections, std::min/max/clamp semantics
+    valarray<double> clipped = where(x < 0.0, 0.0, x), low = min(x, y), high = max(x, 1.5), limited = clamp(x, -2.0, y + 2.0);
+    static_assert(decltype(where(x < 0.0, 0.0, x))::vectorizable == (packet_traits<double>::size > 1), "a mask as wide as the values blends");
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(x[i] < 0 ? 0.0 : x[i], clipped[i]);
+        EXPECT_EQ(std::min(x[i], y[i]), low[i]);
+        EXPECT_EQ(std::max(x[i], 1.5), high[i]);
+        EXPECT_EQ(std::min(std::max(x[i], -2.0), y[i] + 2.0), limited[i]);
+    }
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    valarray<double> odd{ nan, 1.0, -0.0 };
+    valarray<double> other{ 1.0, nan, 0.0 };
+    valarray<double> lo = min(odd, other), hi = max(odd, other);
+    EXPECT_TRUE(std::isnan(lo[0]));
+    EXPECT_EQ(1.0, lo[1]);
+    EXPECT_TRUE(std::signbit(lo[2]));
+    EXPECT_TRUE(std::isnan(hi[0]));
+    EXPECT_TRUE(std::signbit(hi[2]));
+
+    // masks of other widths, and plain arrays (nonzero is true), select element by element
+    valarray<int> k(n);
+    valarray<float> f(n);
+    for (int i = 0; i < n; ++i) {
+        k[i] = i % 3;
+        f[i] = float(i);
+    }
+    valarray<float> fsel = where(k == 1, f, -f);
+    valarray<double> dsel = where(k, x, 100.0);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(k[i] == 1 ? f[i] : -f[i], fsel[i]);
+        EXPECT_EQ(k[i] ? x[i] : 100.0, dsel[i]);
+    }
+
+    // any, all and count, over packets and over the elements on either side of them
+    EXPECT_TRUE((x == 8.0).any());
+    EXPECT_FALSE((x > 8.0).any());
+    EXPECT_TRUE((x >= -8.0).all());
+    EXPECT_FALSE((x > -8.0).all());
+    uint64_t expected = 0;
+    for (int i = 0; i < n; ++i) { expected += x[i] < y[i]; }
+    EXPECT_EQ(expected, (x < y).count());
+    EXPECT_EQ(uint64_t(n - (n + 2) / 3), k.count());
+    uint64_t rising = 0;
+    for (int i = 0; i < n; ++i) { rising += (i + 1 < n ? x[i + 1] : 0.0) > x[i]; }
+    EXPECT_EQ(rising, (shift(x, 1) > x).count());
+    valarray<double> empty;
+    EXPECT_FALSE(empty.any());
+    EXPECT_TRUE(empty.all());
+
+    // large inputs stop early and may be split between threads
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_parallel_threshold(1000);
+    valarray<double> big(1 << 18);
+    big = 1.0;
+    big[(1 << 18) - 3] = -1.0;
+    EXPECT_TRUE((big < 0.0).any());
+    EXPECT_FALSE((big > 0.0).all());
+    EXPECT_EQ(uint64_t((1 << 18) - 1), (big > 0.0).count());
+    epl::set_parallel_threshold(threshold);
+}
+#endif
+
+#if defined(PHASE_C0_19) | defined(PHASE_C)
+TEST(PhaseC, TiedAssignment) {
+    const int n = 1000;
+    valarray<double> x(n), y(n), sum(n), product(n), root(n - 300);
+    for (int i = 0; i < n; ++i) {
+        x[i] = i;
+        y[i] = 3 - i % 5;
+    }
+
+    // one sweep gives what separate assignments give, each output its own prefix
+    snapshot before = snapshot::of<double>();
+    tie(sum, product, root) = pack(x + y, x * y, sqrt(x));
+    snapshot delta = snapshot::of<double>() - before;
+    if (instrumentation_enabled) {
+        EXPECT_EQ(0u, delta.allocations);
+        EXPECT_EQ(0u, delta.materializations);
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(x[i] + y[i], sum[i]);
+        EXPECT_EQ(x[i] * y[i], product[i]);
+    }
+    for (int i = 0; i < n - 300; ++i) {
+        EXPECT_EQ(std::sqrt(x[i]), root[i]);
+    }
+
+    // outputs may be views and of other element types; scalars are operands too
+    valarray<int> k(n);
+    k = 0;
+    tie(k[slice(1, n / 2, 2)], sum) = pack(x, 2.0);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(i % 2 ? (i - 1) / 2 : 0, k[i]);
+        EXPECT_EQ(2.0, sum[i]);
+    }
+
+    // every expression sees the inputs as they were before any output is written
+    valarray<double> a = x, b(n);
+    tie(a, b) = pack(a + 1, a * 2);
+    tie(a, b) = pack(b, a);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(x[i] * 2, a[i]);
+        EXPECT_EQ(x[i] + 1, b[i]);
+    }
+    a = x;
+    tie(a, b) = pack(shift(a, 1), a);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(i + 1 < n ? x[i + 1] : 0.0, a[i]);
+        EXPECT_EQ(x[i], b[i]);
+    }
+
+    // large enough sweeps are split between threads in whole blocks
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_parallel_threshold(1000);
+    const int m = (1 << 16) + 3;
+    valarray<double> big(m), twice(m), square(m);
+    for (int i = 0; i < m; ++i) { big[i] = i % 100; }
+    tie(twice, square) = pack(big * 2.0, big * big);
+    for (int i = 0; i < m; ++i) {
+        ASSERT_EQ(big[i] * 2, twice[i]);
+        ASSERT_EQ(big[i] * big[i], square[i]);
+    }
+    epl::set_parallel_threshold(threshold);
+}
+#endif
+
+#if defined(PHASE_C0_20) | defined(PHASE_C)
+TEST(PhaseC, FusedReductions) {
+    const int n = 10007;
+    valarray<double> x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = std::sin(i * 0.37) * 100;
+        y[i] = i % 7;
+    }
+
+    // every statistic from one pass over x + y, against plain loops
+    auto r = reduce(x + y, stats::sum, stats::sumsq, stats::min, stats::max, stats::argmin, stats::argmax, stats::mean, stats::variance);
+    double sum = 0, sumsq = 0, low = x[0] + y[0], high = low;
+    uint64_t argmin = 0, argmax = 0;
+    for (int i = 0; i < n; ++i) {
+        double v = x[i] + y[i];
+        sum += v;
+        sumsq += v * v;
+        if (v < low) { low = v; argmin = i; }
+        if (v > high) { high = v; argmax = i; }
+    }
+    double mean = sum / n, variance = 0;
+    for (int i = 0; i < n; ++i) { variance += (x[i] + y[i] - mean) * (x[i] + y[i] - mean); }
+    variance /= n;
+    EXPECT_NEAR(sum, std::get<0>(r), 1e-9);
+    EXPECT_NEAR(sumsq, std::get<1>(r), 1e-6);
+    EXPECT_EQ(low, std::get<2>(r));
+    EXPECT_EQ(high, std::get<3>(r));
+    EXPECT_EQ(argmin, std::get<4>(r));
+    EXPECT_EQ(argmax, std::get<5>(r));
+    EXPECT_NEAR(mean, std::get<6>(r), 1e-12);
+    EXPECT_NEAR(variance, std::get<7>(r), 1e-9);
+
+    // the first of equal extremes, wherever the lanes and blocks split them
+    valarray<int> k(n);
+    k = 3;
+    k[n - 1] = 9;
+    k[5000] = 9;
+    k[17] = -1;
+    k[4099] = -1;
+    auto ri = reduce(k, stats::argmin, stats::argmax, stats::min, stats::mean);
+    EXPECT_EQ(17u, std::get<0>(ri));
+    EXPECT_EQ(5000u, std::get<1>(ri));
+    EXPECT_EQ(-1, std::get<2>(ri));
+    EXPECT_NEAR((3.0 * (n - 4) + 18 - 2) / n, std::get<3>(ri), 1e-12);
+
+    // stable where naive formulas are not: a large offset, many small terms
+    valarray<float> f(n);
+    for (int i = 0; i < n; ++i) { f[i] = 1e4f + (i % 2 ? 1.0f : -1.0f); }
+    EXPECT_NEAR(1.0, std::get<0>(reduce(f, stats::variance)), 1e-3);
+    f = 0.1f;
+    EXPECT_NEAR(0.1 * n, std::get<0>(reduce(f, stats::sum)), 5e-2);
+
+    // conveniences
+    double dotted = 0;
+    for (int i = 0; i < n; ++i) { dotted += x[i] * y[i]; }
+    EXPECT_NEAR(dotted, dot(x, y), 1e-9);
+    EXPECT_NEAR(std::sqrt(sumsq), norm2(x + y), 1e-9);
+    valarray<int> wide{ 50000, 50000 };
+    EXPECT_NEAR(50000.0 * std::sqrt(2.0), norm2(wide), 1e-9);
+    EXPECT_NEAR(100000.0, norm2(valarray<int>{ 100000 }), 1e-9);
+    EXPECT_NEAR(3e5 * std::sqrt(1001.0), norm2(valarray<int>(1001) + 300000), 1e-6);
+    EXPECT_NEAR(mean, (x + y).mean(), 1e-12);
+    std::pair<double, double> range = (x + y).minmax();
+    EXPECT_EQ(low, range.first);
+    EXPECT_EQ(high, range.second);
+    valarray<double> empty;
+    EXPECT_TRUE(std::isnan(empty.mean()));
+    EXPECT_EQ(0.0, std::get<0>(reduce(empty, stats::sum)));
+    EXPECT_EQ(0u, std::get<0>(reduce(empty, stats::argmax)));
+
+    // split between threads, with the same results for any number of them
+    unsigned threads = epl::num_threads();
+    uint64_t threshold = epl::parallel_threshold();
+    epl::set_parallel_threshold(1000);
+    const int m = (1 << 18) + 5;
+    valarray<double> big(m);
+    for (int i = 0; i < m; ++i) { big[i] = std::cos(i * 0.01) + 1e-3 * (i % 10); }
+    epl::set_num_threads(1);
+    auto one = reduce(big * 2.0, stats::sum, stats::variance, stats::argmax);
+    epl::set_num_threads(4);
+    auto four = reduce(big * 2.0, stats::sum, stats::variance, stats::argmax);
+    EXPECT_EQ(std::get<0>(one), std::get<0>(four));
+    EXPECT_EQ(std::get<1>(one), std::get<1>(four));
+    EXPECT_EQ(std::get<2>(one), std::get<2>(four));
+    epl::set_num_threads(threads);
+    epl::set_parallel_threshold(threshold);
+}
+#endif
+
+#if defined(PHASE_C0_21) | defined(PHASE_C)
+TEST(PhaseC, FusedMultiplyAdd) {
+    const int n = 1000;
+    valarray<double> a(n), b(n), c(n);
+    valarray<float> f(n), g(n);
+    valarray<int> k(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = 1.0 + i * 1e-3;
+        b[i] = 1.0 / (i + 3);
+        c[i] = -a[i] * b[i] + 1e-9 * i;
+        f[i] = 0.1f * i;
+        g[i] = 3.0f - 0.01f * i;
+        k[i] = i - 500;
+    }
+
+    valarray<double> sum = a * b + c, sum2 = c + a * b, difference = a * b - c, negated = c - a * b, scaled = a * 2.0 + 1.0;
+    valarray<float> single = f * g + f;
+#ifdef EPL_FMA
+    // one rounding per element: exactly std::fma, in the packets and the tail
+    static_assert(std::is_base_of<FmaProxy<vector<double>, vector<double>, vector<double>, multiply_add<double>>, decltype(a * b + c)>::value, "a * b + c fuses");
+    static_assert(std::is_base_of<FmaProxy<vector<double>, vector<double>, vector<double>, multiply_add<double, -1, 1>>, decltype(c - a * b)>::value, "c - a * b fuses");
+    static_assert(decltype(a * b + c)::vectorizable == (packet_traits<double>::size > 1), "fused nodes vectorize");
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(std::fma(a[i], b[i], c[i]), sum[i]);
+        EXPECT_EQ(std::fma(a[i], b[i], c[i]), sum2[i]);
+        EXPECT_EQ(std::fma(a[i], b[i], -c[i]), difference[i]);
+        EXPECT_EQ(std::fma(-a[i], b[i], c[i]), negated[i]);
+        EXPECT_EQ(std::fma(a[i], 2.0, 1.0), scaled[i]);
+        EXPECT_EQ(std::fma(f[i], g[i], f[i]), single[i]);
+    }
+#else
+    // c nearly cancels a * b; the compiler may contract the loop's a * b + c on its own
+    for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(a[i] * b[i] + c[i], sum[i], 1e-15);
+        EXPECT_NEAR(c[i] + a[i] * b[i], sum2[i], 1e-15);
+        EXPECT_NEAR(a[i] * b[i] - c[i], difference[i], 1e-15);
+        EXPECT_NEAR(c[i] - a[i] * b[i], negated[i], 1e-15);
+        EXPECT_FLOAT_EQ(f[i] * g[i] + f[i], single[i]);
+    }
+#endif
+
+    // integers, and products bound to a name, keep the separate operations
+    static_assert(std::is_base_of<BinaryProxy<BinaryProxy<vector<int>, vector<int>, std::multiplies<int>>, vector<int>, std::plus<int>>, decltype(k * k + k)>::value, "integers do not fuse");
+    auto product = a * b;
+    static_assert(std::is_base_of<BinaryProxy<BinaryProxy<vector<double>, vector<double>, std::multiplies<double>>, vector<double>, std::plus<double>>, decltype(product + c)>::value, "named products do not fuse");
+    valarray<int> ints = k * k - k;
+    valarray<double> named = product + c;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(k[i] * k[i] - k[i], ints[i]);
+        EXPECT_NEAR(a[i] * b[i] + c[i], named[i], 1e-15);
+    }
+}
+#endif
+
+#if defined(PHASE_C0_22) | defined(PHASE_C)
+TEST(PhaseC, AlgebraicRewrites) {
+    const int n = 100;
+    valarray<double> x(n), y(n);
+    valarray<int> k(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = 0.5 + i;
+        y[i] = 3.0 - i * 0.25;
+        k[i] = i - 50;
+    }
+    using Vec = vector<double>;
+
+    // exact rewrites, always on
+    static_assert(std::is_base_of<BinaryProxy<Vec, Vec, std::minus<double>>, decltype(x + (-y))>::value, "x + (-y) is x - y");
+    static_assert(std::is_base_of<BinaryProxy<Vec, Vec, std::plus<double>>, decltype(x - (-y))>::value, "x - (-y) is x + y");
+    static_assert(std::is_base_of<UnaryProxy<Vec, positive<double>>, decltype(-(-x))>::value, "-(-x) reads x");
+    static_assert(std::is_base_of<BinaryProxy<Vec, Vec, std::plus<double>>, decltype(-(-(x + y)))>::value, "-(-e) is e");
+    static_assert(std::is_base_of<BinaryProxy<Vec, Scalar<double>, std::multiplies<double>>, decltype(-(x * 3))>::value, "-(x * s) is x * (-s)");
+    static_assert(std::is_base_of<BinaryProxy<vector<int>, Scalar<int>, std::multiplies<int>>, decltype((k * 2) * 3)>::value, "integer scalars fold");
+    static_assert(std::is_base_of<UnaryProxy<vector<int>, divided_by<int>>, decltype(k / 2)>::value, "integers divide by a multiplication");
+
+    // regrouping floating point scalars, only with EPL_FAST_FP
+#if defined(EPL_FAST_FP) && !defined(EPL_STRICT_FP)
+    static_assert(std::is_base_of<BinaryProxy<Vec, Scalar<double>, std::multiplies<double>>, decltype(3 * (2 * x))>::value, "scalars fold");
+    static_assert(std::is_base_of<BinaryProxy<Vec, Scalar<double>, std::minus<double>>, decltype((x - 1.0) - 2.0)>::value, "subtracted scalars fold");
+#else
+    static_assert(std::is_base_of<BinaryProxy<BinaryProxy<Vec, Scalar<double>, std::minus<double>>, Scalar<double>, std::minus<double>>, decltype((x - 1.0) - 2.0)>::value, "floating point scalars keep their order");
+#endif
+
+    // dividing by a reciprocal, unless EPL_STRICT_FP
+#ifndef EPL_STRICT_FP
+    static_assert(std::is_base_of<UnaryProxy<Vec, divided_by<double>>, decltype(x / 2.0)>::value, "x / s is x * (1 / s)");
+#else
+    static_assert(std::is_base_of<BinaryProxy<BinaryProxy<Vec, Scalar<double>, std::divides<double>>, Scalar<double>, std::divides<double>>, decltype(x / 2.0 / 4.0)>::value, "strict division");
+#endif
+
+    // the results of the written expressions, at the ends of the range too
+    valarray<double> one{ 1.0, 3.0 }, tiny{ 1e-300, 1.0 };
+    valarray<float> tinyf{ 1e-30f, 1.0f };
+    valarray<double> by_subnormal = tiny / 1e-310;
+    valarray<float> by_subnormalf = tinyf / 1e-40f;
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(tiny[i] / 1e-310, by_subnormal[i]);
+        EXPECT_EQ(tinyf[i] / 1e-40f, by_subnormalf[i]);
+    }
+    EXPECT_NEAR(1e10, by_subnormal[0], 1e5);
+    EXPECT_NEAR(1e10f, by_subnormalf[0], 1e6f);
+#ifndef EPL_FAST_FP
+    valarray<double> cancelled = (one + 1e16) + (-1e16), underflowed = (tiny * 1e-200) * 1e200;
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ((one[i] + 1e16) + (-1e16), cancelled[i]);
+        EXPECT_EQ((tiny[i] * 1e-200) * 1e200, underflowed[i]);
+    }
+    EXPECT_EQ(0.0, cancelled[0]);
+    EXPECT_EQ(0.0, underflowed[0]);
+#endif
+
+    valarray<double> sum = x + (-y), difference = x - (-y), same = -(-x), negated = -(x * 3.0);
+    valarray<double> folded = (x * 2.0) * 3.0, shifted = (x - 1.0) - 2.0, quarter = x / 2.0 / 2.0, third = x / 3.0;
+    valarray<int> ints = (k * 2) * 3, halves = k / 2;
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(x[i] - y[i], sum[i]);
+        EXPECT_EQ(x[i] + y[i], difference[i]);
+        EXPECT_EQ(x[i], same[i]);
+        EXPECT_EQ(-(x[i] * 3.0), negated[i]);
+        EXPECT_DOUBLE_EQ(x[i] * 6.0, folded[i]);
+        EXPECT_DOUBLE_EQ(x[i] - 3.0, shifted[i]);
+        EXPECT_EQ(x[i] / 4.0, quarter[i]);
+        EXPECT_DOUBLE_EQ(x[i] / 3.0, third[i]);
+        EXPECT_EQ(k[i] * 6, ints[i]);
+        EXPECT_EQ(k[i] / 2, halves[i]);
+    }
+
+    // the rewritten nodes still read the arrays, not copies of them
+    auto lazy = -(-x);
+    x[0] = 42.0;
+    EXPECT_EQ(42.0, lazy[0]);
+
+    // named nodes are read as written
+    auto product = x * 2.0;
+    static_assert(std::is_base_of<BinaryProxy<BinaryProxy<Vec, Scalar<double>, std::multiplies<double>>, Scalar<double>, std::multiplies<double>>, decltype(product * 3.0)>::value, "named nodes do not fold");
+}
+#endif
+
+#if defined(PHASE_C0_23) | defined(PHASE_C)
+TEST(PhaseC, InvariantDivision) {
+    const int divisors[] = {1, -1, 2, -2, 3, -3, 7, 10, -10, 64, 100, 641, -1000, 1 << 30, -(1 << 30), INT_MAX, INT_MIN};
+    const int edges[] = {0, 1, -1, 2, -2, 99, -99, 100, -100, INT_MAX, INT_MIN, INT_MAX - 1, INT_MIN + 1};
+    const int n = 1031;  // not a whole number of packets
+    valarray<int> x(n);
+    uint32_t state = 12345;
+    for (int i = 0; i < n; ++i) {
+        state = state * 1664525u + 1013904223u;
+        x[i] = i < 13 ? edges[i] : int(state);
+    }
+
+    static_assert(std::is_base_of<UnaryProxy<vector<int>, divided_by<int>>, decltype(x / 3)>::value, "int / scalar");
+    static_assert(std::is_base_of<BinaryProxy<Scalar<int>, vector<int>, std::divides<int>>, decltype(3 / x)>::value, "scalar / int divides");
+
+    for (int d : divisors) {
+        valarray<int> q = x / d, chained = (x / 2 + 1) / d;
+        for (int i = 0; i < n; ++i) {
+            if (!(x[i] == INT_MIN && d == -1)) {
+                EXPECT_EQ(x[i] / d, q[i]) << x[i] << " / " << d;
+            }
+            EXPECT_EQ((x[i] / 2 + 1) / d, chained[i]);
+        }
+    }
+
+    // the divisor is a runtime value, read once when the node is built
+    int bucket = 16;
+    auto buckets = x / bucket;
+    bucket = 1;
+    EXPECT_EQ(x[20] / 16, buckets[20]);
+}
+#endif
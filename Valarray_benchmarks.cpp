@@ -0,0 +1,253 @@
+/*
+ * Valarray_benchmarks.cpp
+ * Throughput of valarray expressions against std::valarray, hand written
+ * std::vector loops and raw pointer loops, and of complex expressions on
+ * split (complex_valarray) against interleaved storage.
+ *
+ * Build (Google Benchmark):
+ *     g++ -std=c++14 -O3 -march=native Valarray_benchmarks.cpp -lbenchmark -pthread
+ * Useful flags: --benchmark_filter=Depth2, --benchmark_counters_tabular=true.
+ *
+ * Every case reports
+ *     bytes_per_second  memory traffic (arrays read plus the one written)
+ *     elements/ns       destination elements produced per nanosecond
+ *     allocs/iter       epl::vector buffer allocations per iteration
+ * Sizes run from L1-resident (1K elements) to DRAM-sized (16M elements).
+ */
+
+#include <complex>
+#include <cstdint>
+#include <valarray>
+#include <vector>
+
+#include "InstanceCounter.h"
+#include "Valarray.h"
+
+#include "benchmark/benchmark.h"
+
+int InstanceCounter::counter = 0;
+
+using std::complex;
+
+/*********************************************************************/
+// Expressions, one per tree depth. Each is written once as a generic
+// expression (valarray and std::valarray) and once per element (loops).
+/*********************************************************************/
+
+struct Depth1 {
+    static constexpr int reads = 2;
+
+    template <typename A>
+    static auto expr(const A& a, const A& b, const A&, const A&) -> decltype(a + b) { return a + b; }
+
+    template <typename T>
+    static T element(T a, T b, T, T) { return a + b; }
+};
+
+struct Depth2 {
+    static constexpr int reads = 3;
+
+    template <typename A>
+    static auto expr(const A& a, const A& b, const A& c, const A&) -> decltype(a * b + c) { return a * b + c; }
+
+    template <typename T>
+    static T element(T a, T b, T c, T) { return a * b + c; }
+};
+
+struct Depth3 {
+    static constexpr int reads = 4;
+
+    template <typename A>
+    static auto expr(const A& a, const A& b, const A& c, const A& d) -> decltype((a * b + c) * d) { return (a * b + c) * d; }
+
+    template <typename T>
+    static T element(T a, T b, T c, T d) { return (a * b + c) * d; }
+};
+
+struct Depth4 {
+    static constexpr int reads = 4;
+
+    template <typename A>
+    static auto expr(const A& a, const A& b, const A& c, const A& d) -> decltype((a * b + c * d) / (a + b)) { return (a * b + c * d) / (a + b); }
+
+    template <typename T>
+    static T element(T a, T b, T c, T d) { return (a * b + c * d) / (a + b); }
+};
+
+/* inputs stay small and positive so integer division never sees zero */
+template <typename T>
+T input(uint64_t i, int k) {
+    return T((i + k) % 7 + 1);
+}
+
+template <typename Expr, typename T>
+void report(benchmark::State& state, uint64_t n, uint64_t allocations) {
+    int64_t elements = int64_t(state.iterations()) * n;
+    state.SetItemsProcessed(elements);
+    state.SetBytesProcessed(elements * (Expr::reads + 1) * int64_t(sizeof(T)));
+    state.counters["elements/ns"] = benchmark::Counter(double(elements) * 1e-9, benchmark::Counter::kIsRate);
+    state.counters["allocs/iter"] = benchmark::Counter(double(allocations) / state.iterations());
+}
+
+/*********************************************************************/
+// Implementations
+/*********************************************************************/
+
+template <typename Expr, typename T>
+void Valarray(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    valarray<T> a(n), b(n), c(n), d(n), out(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        a[i] = input<T>(i, 0);
+        b[i] = input<T>(i, 1);
+        c[i] = input<T>(i, 2);
+        d[i] = input<T>(i, 3);
+    }
+
+    epl::snapshot before = epl::snapshot::all();
+    for (auto _ : state) {
+        out = Expr::expr(a, b, c, d);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    report<Expr, T>(state, n, (epl::snapshot::all() - before).allocations);
+}
+
+/* constructing the result each iteration: the cost of materialization */
+template <typename Expr, typename T>
+void ValarrayConstruct(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    valarray<T> a(n), b(n), c(n), d(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        a[i] = input<T>(i, 0);
+        b[i] = input<T>(i, 1);
+        c[i] = input<T>(i, 2);
+        d[i] = input<T>(i, 3);
+    }
+
+    epl::snapshot before = epl::snapshot::all();
+    for (auto _ : state) {
+        valarray<T> out = Expr::expr(a, b, c, d);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    report<Expr, T>(state, n, (epl::snapshot::all() - before).allocations);
+}
+
+/* complex<T> kept as separate planes of real and imaginary parts */
+template <typename Expr, typename T>
+void SplitComplex(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    complex_valarray<T> a(n), b(n), c(n), d(n), out(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        a[i] = input<complex<T>>(i, 0);
+        b[i] = input<complex<T>>(i, 1);
+        c[i] = input<complex<T>>(i, 2);
+        d[i] = input<complex<T>>(i, 3);
+    }
+
+    epl::snapshot before = epl::snapshot::all();
+    for (auto _ : state) {
+        out = Expr::expr(a, b, c, d);
+        benchmark::DoNotOptimize(out.real_data());
+        benchmark::ClobberMemory();
+    }
+    report<Expr, complex<T>>(state, n, (epl::snapshot::all() - before).allocations);
+}
+
+template <typename Expr, typename T>
+void StdValarray(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    std::valarray<T> a(n), b(n), c(n), d(n), out(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        a[i] = input<T>(i, 0);
+        b[i] = input<T>(i, 1);
+        c[i] = input<T>(i, 2);
+        d[i] = input<T>(i, 3);
+    }
+
+    for (auto _ : state) {
+        out = Expr::expr(a, b, c, d);
+        benchmark::DoNotOptimize(&out[0]);
+        benchmark::ClobberMemory();
+    }
+    report<Expr, T>(state, n, 0);
+}
+
+template <typename Expr, typename T>
+void VectorLoop(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    std::vector<T> a(n), b(n), c(n), d(n), out(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        a[i] = input<T>(i, 0);
+        b[i] = input<T>(i, 1);
+        c[i] = input<T>(i, 2);
+        d[i] = input<T>(i, 3);
+    }
+
+    for (auto _ : state) {
+        for (uint64_t i = 0; i < n; ++i) {
+            out[i] = Expr::element(a[i], b[i], c[i], d[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    report<Expr, T>(state, n, 0);
+}
+
+template <typename Expr, typename T>
+void RawPointers(benchmark::State& state) {
+    uint64_t n = state.range(0);
+    std::vector<T> storage(5 * n);
+    const T* __restrict a = storage.data();
+    const T* __restrict b = a + n;
+    const T* __restrict c = b + n;
+    const T* __restrict d = c + n;
+    T* __restrict out = storage.data() + 4 * n;
+    for (uint64_t i = 0; i < n; ++i) {
+        storage[i] = input<T>(i, 0);
+        storage[n + i] = input<T>(i, 1);
+        storage[2 * n + i] = input<T>(i, 2);
+        storage[3 * n + i] = input<T>(i, 3);
+    }
+
+    for (auto _ : state) {
+        for (uint64_t i = 0; i < n; ++i) {
+            out[i] = Expr::element(a[i], b[i], c[i], d[i]);
+        }
+        benchmark::DoNotOptimize(out);
+        benchmark::ClobberMemory();
+    }
+    report<Expr, T>(state, n, 0);
+}
+
+/*********************************************************************/
+// Registration
+/*********************************************************************/
+
+#define SIZES RangeMultiplier(16)->Range(1 << 10, 1 << 24)->UseRealTime()
+
+#define BENCH_EXPR(Expr, T) \
+    BENCHMARK_TEMPLATE(Valarray, Expr, T)->SIZES; \
+    BENCHMARK_TEMPLATE(ValarrayConstruct, Expr, T)->SIZES; \
+    BENCHMARK_TEMPLATE(StdValarray, Expr, T)->SIZES; \
+    BENCHMARK_TEMPLATE(VectorLoop, Expr, T)->SIZES; \
+    BENCHMARK_TEMPLATE(RawPointers, Expr, T)->SIZES;
+
+#define BENCH_TYPE(T) \
+    BENCH_EXPR(Depth1, T) \
+    BENCH_EXPR(Depth2, T) \
+    BENCH_EXPR(Depth3, T) \
+    BENCH_EXPR(Depth4, T)
+
+BENCH_TYPE(int)
+BENCH_TYPE(float)
+BENCH_TYPE(double)
+BENCH_TYPE(complex<double>)
+
+BENCHMARK_TEMPLATE(SplitComplex, Depth1, double)->SIZES;
+BENCHMARK_TEMPLATE(SplitComplex, Depth2, double)->SIZES;
+BENCHMARK_TEMPLATE(SplitComplex, Depth3, double)->SIZES;
+BENCHMARK_TEMPLATE(SplitComplex, Depth4, double)->SIZES;
+
+BENCHMARK_MAIN();
@@ -11,15 +11,28 @@
 #define VECTOR_HPP_
 
 #include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
+#include "Allocator.h"
 #include "InstanceCounter.h"
+#include "Instrumentation.h"
 
 namespace epl {
 
-template <typename T>
+/* tag selecting the sized constructor that skips initializing its elements */
+struct uninitialized_t { explicit uninitialized_t(void) = default; };
+constexpr uninitialized_t uninitialized{};
+
+/*
+ * Alloc is the allocation policy (see Allocator.h); the default is the C heap
+ * (malloc, realloc and free), epl::aligned_allocator<> and
+ * epl::huge_page_allocator are the alternatives shipped with the library
+ */
+template <typename T, typename Alloc = default_allocator>
 class vector {
 private:
 	/*
@@ -39,11 +52,16 @@ private:
 	T* dend; // end of data
 	
 	const uint64_t minimum_capacity = 8;
+
+	/* elements that can be relocated and copied with memcpy */
+	using trivial = std::integral_constant<bool, std::is_trivially_copyable<T>::value>;
+	/* ...and whose storage can be resized in place by the allocation policy */
+	using resizable = std::integral_constant<bool, trivial::value && can_reallocate<Alloc>::value>;
 public:
 	using value_type=T;
 	vector(void) {
 		uint64_t capacity = minimum_capacity;
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
 		send = sbegin + capacity;
 		dbegin = dend = sbegin;
 
@@ -53,7 +71,7 @@ public:
 	explicit vector(uint64_t sz) {
 		uint64_t capacity = sz;
 		if (sz == 0) { capacity = minimum_capacity; }
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
 		send = sbegin + capacity;
 		dbegin = dend = sbegin;
 		for (uint64_t k = 0; k < sz; k += 1) {
@@ -64,24 +82,47 @@ public:
         InstanceCounter();
 	}
 
-	vector(const vector<T>& that) {
-        std::cout << "epl::vector copy constructor" << std::endl;
+	/*
+	 * storage for exactly sz elements, for callers that are about to overwrite
+	 * every one of them. Trivially copyable elements are left unwritten; any
+	 * other type is value-initialized as in vector(sz).
+	 */
+	vector(uint64_t sz, uninitialized_t) {
+		uint64_t capacity = sz;
+		if (sz == 0) { capacity = minimum_capacity; }
+		sbegin = allocate(capacity);
+		send = sbegin + capacity;
+		dbegin = dend = sbegin;
+		if (std::is_trivially_copyable<T>::value) {
+			dend += sz;
+		} else {
+			for (uint64_t k = 0; k < sz; k += 1) {
+				new (dend) T();
+				++dend;
+			}
+		}
+
+        InstanceCounter();
+	}
+
+	vector(const vector& that) {
         copy(that);
 
         InstanceCounter();
     }
 
-	template <typename AltType>
-	vector(const vector<AltType>& that) {
+	template <typename AltType, typename AltAlloc>
+	vector(const vector<AltType, AltAlloc>& that) {
 		uint64_t capacity = that.size();
 		if (capacity == 0) { capacity = minimum_capacity; }
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
 		send = sbegin + capacity;
 		dbegin = dend = sbegin;
-		for (uint64_t k = 0; k < capacity; k += 1) {
+		for (uint64_t k = 0; k < that.size(); k += 1) {
 			new (dend) T(that[k]);
 			++dend;
 		}
+		instrumentation::copied<T>();
 
         InstanceCounter();
 	}
@@ -97,7 +138,7 @@ public:
         vector(il.begin(), il.end()) {
 	}
 
-	vector(vector<T>&& that) {
+	vector(vector&& that) {
         move(std::move(that)); 
 
         InstanceCounter();
@@ -105,7 +146,7 @@ public:
 	
     ~vector(void) { destroy(); }
 
-    vector<T>& operator=(const vector<T>& that) {
+    vector& operator=(const vector& that) {
 		if (this != &that) {
 			destroy();
 			copy(that);
@@ -113,14 +154,20 @@ public:
         return *this;
 	}
 
-	vector<T>& operator=(vector<T>&& that) {
-		destroy();
-		move(std::move(that));
+	vector& operator=(vector&& that) {
+		if (this != &that) {
+			destroy();
+			move(std::move(that));
+		}
 		return *this;
 	}
 
 	uint64_t size(void) const { return dend - dbegin; }
 
+	/* unchecked access to the contiguous element storage */
+	T* data(void) { return dbegin; }
+	const T* data(void) const { return dbegin; }
+
 	T& operator[](uint64_t k) {
 		T* p = dbegin + k;
 		if (p >= dend) { throw std::out_of_range("subscript out of range"); }
@@ -151,6 +198,7 @@ public:
 	void emplace_back(Args... args) {
 		ensure_back_capacity(1);
 		new(dend) T(args...);
+		++dend;
 	}
 
 	void push_front(const T& that) {
@@ -204,15 +252,22 @@ public:
 		return *(dend - 1);
 	}
 
-  class iterator;
-	class const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
-		const vector<T>* parent;
+	class iterator;
+	/* random access iterators over the elements; they stay valid until the vector reallocates */
+	class const_iterator {
+		const vector* parent;
 		uint64_t index;
 		const T* ptr;
 
 		using Same = const_iterator;
 
 	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = T;
+		using difference_type = int64_t;
+		using pointer = const T*;
+		using reference = const T&;
+
 		const_iterator(void) {
 			index = 0;
 			ptr = nullptr;
@@ -223,6 +278,14 @@ public:
 			return *ptr;
 		}
 
+		const T* operator->(void) const {
+			return ptr;
+		}
+
+		const T& operator[](int64_t k) const {
+			return ptr[k];
+		}
+
 		Same& operator++(void) {
 			++ptr;
 			++index;
@@ -241,19 +304,38 @@ public:
 			return *this;
 		}
 
-
 		Same operator--(int) {
 			Same t(*this);
 			this->operator--();
 			return t;
 		}
 
-		int64_t operator-(const const_iterator that) const {
-			return this->ptr - that.ptr;
+		Same& operator+=(int64_t k) {
+			ptr += k;
+			index += k;
+			return *this;
+		}
+
+		Same& operator-=(int64_t k) {
+			return *this += -k;
+		}
+
+		Same operator+(int64_t k) const {
+			Same t(*this);
+			return t += k;
+		}
+
+		Same operator-(int64_t k) const {
+			Same t(*this);
+			return t -= k;
 		}
 
-		const_iterator operator+(int64_t k) {
-			return iterator(parent, ptr + k);
+		friend Same operator+(int64_t k, const Same& it) {
+			return it + k;
+		}
+
+		int64_t operator-(const const_iterator& that) const {
+			return this->ptr - that.ptr;
 		}
 
 		bool operator==(const Same& that) const {
@@ -266,11 +348,16 @@ public:
 			return ! (*this == that);
 		}
 
-		friend vector<T>;
-        friend vector<T>::iterator;
+		bool operator<(const Same& that) const { return this->ptr < that.ptr; }
+		bool operator>(const Same& that) const { return that < *this; }
+		bool operator<=(const Same& that) const { return ! (that < *this); }
+		bool operator>=(const Same& that) const { return ! (*this < that); }
+
+		friend vector;
+		friend vector::iterator;
 
 	private:
-		const_iterator(const vector<T>* parent, const T* ptr) {
+		const_iterator(const vector* parent, const T* ptr) {
 			this->parent = parent;
 			this->ptr = ptr;
 			this->index = ptr - parent->dbegin;
@@ -282,23 +369,37 @@ public:
 		using Same = iterator;
 		using Base = const_iterator;
 	public:
+		using pointer = T*;
+		using reference = T&;
+
 		iterator(void) {}
-		
-    T& operator*(void) const {
-			return const_cast<T&>(const_iterator::operator*());
+
+		T& operator*(void) const {
+			return const_cast<T&>(Base::operator*());
 		}
 
-    iterator operator+(int64_t k) {
-      const_iterator::operator+(k); //calls checkRevision for us
-      return iterator(const_iterator::parent, const_iterator::ptr + k);
+		T* operator->(void) const {
+			return const_cast<T*>(Base::operator->());
 		}
+
+		T& operator[](int64_t k) const {
+			return const_cast<T&>(Base::operator[](k));
+		}
+
 		Same& operator++(void) { Base::operator++(); return *this; }
 		Same operator++(int) { Same t(*this); operator++(); return t; }
 		Same& operator--(void) { Base::operator--(); return *this; }
 		Same operator--(int) { Same t(*this); operator--(); return t; }
+		Same& operator+=(int64_t k) { Base::operator+=(k); return *this; }
+		Same& operator-=(int64_t k) { Base::operator-=(k); return *this; }
+		Same operator+(int64_t k) const { Same t(*this); return t += k; }
+		Same operator-(int64_t k) const { Same t(*this); return t -= k; }
+		friend Same operator+(int64_t k, const Same& it) { return it + k; }
+		using Base::operator-;
+
 	private:
-		friend vector<T>;
-		iterator(const vector<T>* parent, const T* ptr) : const_iterator(parent, ptr) { }
+		friend vector;
+		iterator(const vector* parent, const T* ptr) : const_iterator(parent, ptr) { }
 	};
 
 	const_iterator begin(void) const { return const_iterator(this, dbegin); }
@@ -310,15 +411,29 @@ public:
 private:
 	void destroy(void) {
 		if (sbegin != nullptr) {
-			while (dbegin != dend) {
-				dbegin->~T();
-				++dbegin;
+			if (!std::is_trivially_destructible<T>::value) {
+				while (dbegin != dend) {
+					dbegin->~T();
+					++dbegin;
+				}
 			}
-			operator delete(sbegin);
+			deallocate(sbegin, send - sbegin);
 		}
 	}
 
-	void copy(const vector<T>& that) {
+	static T* allocate(uint64_t capacity) {
+		if (capacity > UINT64_MAX / sizeof(T)) { throw std::length_error("vector capacity overflow"); }
+		T* storage = reinterpret_cast<T*>(Alloc::allocate(capacity * sizeof(T)));
+		instrumentation::allocated<T>(capacity * sizeof(T));
+		return storage;
+	}
+
+	static void deallocate(T* storage, uint64_t capacity) {
+		if (storage != nullptr) { instrumentation::deallocated<T>(); }
+		Alloc::deallocate(storage, capacity * sizeof(T));
+	}
+
+	void copy(const vector& that) {
 		/* there is nothing preventing me from using the "private" parts of that
 		 * as I implement this function (since this and that are the same type)
 		 * However... someday I might want to have a member template where that
@@ -328,27 +443,42 @@ private:
 		 */
 		uint64_t capacity = that.size();
 		if (capacity < minimum_capacity) { capacity = minimum_capacity; }
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
+		send = sbegin + capacity;
 		dbegin = dend = sbegin;
-		for (uint64_t k = 0; k < that.size(); k += 1) {
-			new (dend) T(that[k]);
+		append(that.data(), that.data() + that.size(), trivial{});
+		instrumentation::copied<T>();
+	}
+
+	/* copy constructs [b, e) after dend (which must have room for them) */
+	void append(const T* b, const T* e, std::true_type) {
+		if (b != e) { std::memcpy(dend, b, (e - b) * sizeof(T)); }
+		dend += e - b;
+	}
+
+	void append(const T* b, const T* e, std::false_type) {
+		while (b != e) {
+			new (dend) T(*b);
 			++dend;
+			++b;
 		}
 	}
 
-	void move(vector<T>&& that) {
+	void move(vector&& that) {
 		sbegin = that.sbegin;
 		send = that.send;
 		dbegin = that.dbegin;
 		dend = that.dend;
 		that.sbegin = that.send = that.dbegin = that.dend = nullptr;
+		instrumentation::moved<T>();
 	}
 
 	template <typename Iterator>
 	void constructFromIterator(Iterator b, Iterator e, std::random_access_iterator_tag) {
 		uint64_t capacity = (uint64_t) (e - b);
 		if (capacity < minimum_capacity) { capacity = minimum_capacity; }
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
+		send = sbegin + capacity;
 		dbegin = dend = sbegin;
 		while (b != e) {
 			new (dend) T(*b);
@@ -357,10 +487,25 @@ private:
 		}
 	}
 
+	/* pointers into T arrays (initializer lists included) are copied in bulk */
+	void constructFromIterator(const T* b, const T* e, std::random_access_iterator_tag) {
+		uint64_t capacity = (uint64_t) (e - b);
+		if (capacity < minimum_capacity) { capacity = minimum_capacity; }
+		sbegin = allocate(capacity);
+		send = sbegin + capacity;
+		dbegin = dend = sbegin;
+		append(b, e, trivial{});
+	}
+
+	void constructFromIterator(T* b, T* e, std::random_access_iterator_tag) {
+		constructFromIterator(const_cast<const T*>(b), const_cast<const T*>(e), std::random_access_iterator_tag{});
+	}
+
 	template <typename Iterator>
 	void constructFromIterator(Iterator b, Iterator e, std::forward_iterator_tag) {
 		uint64_t capacity = minimum_capacity;
-		sbegin = reinterpret_cast<T*>(operator new(capacity * sizeof(T)));
+		sbegin = allocate(capacity);
+		send = sbegin + capacity;
 		dbegin = dend = sbegin;
 		while (b != e) {
 			push_back(*b);
@@ -373,8 +518,9 @@ private:
 			return;
 		}
 
-		/* try doubling capacity */
+		/* try doubling capacity (a moved-from vector has none) */
 		uint64_t capacity = 2 * (send - sbegin);
+		if (capacity == 0) { capacity = minimum_capacity; }
 
 		while (capacity < back_capacity) {
 			capacity *= 2;
@@ -383,21 +529,54 @@ private:
 		/* set the back_capacity to either half of the excess capacity we have
 		 * or to the requested capacity (back_capacity), whichever is greater.
 		 */
+		uint64_t requested = back_capacity;
 		uint64_t excess_capacity = capacity - size();
 		if (back_capacity < excess_capacity / 2) { back_capacity = excess_capacity / 2; }
 
-		T* new_storage = reinterpret_cast<T*>(operator new(sizeof(T) * capacity));
-		T* new_data = new_storage + capacity - back_capacity - size();
-		T* new_data_end = new_data;
+		/* storage that can grow in place keeps its front capacity if that
+		 * still leaves the requested room at the back */
+		uint64_t offset = capacity - back_capacity - size();
+		if (resizable::value && capacity - (dbegin - sbegin) - size() >= requested) {
+			offset = dbegin - sbegin;
+		}
+		reallocate(capacity, offset, resizable{});
+	}
 
-		/* move the elements (and deconstruct the originals) */
-		while (dbegin != dend) {
-			new (new_data_end) T(std::move(*dbegin));
-			dbegin->~T();
-			++dbegin;
-			++new_data_end;
+	/*
+	 * replaces the storage with capacity elements, the data starting at offset.
+	 * Trivially copyable elements are moved with memcpy, or with realloc (which
+	 * can remap large buffers without copying them) when the policy supports it.
+	 */
+	void reallocate(uint64_t capacity, uint64_t offset, std::true_type) {
+		uint64_t n = size();
+		uint64_t front = dbegin - sbegin;
+		uint64_t old_capacity = send - sbegin;
+		bool fresh = sbegin == nullptr; // sbegin may be freed by the call
+		T* new_storage = reinterpret_cast<T*>(Alloc::reallocate(sbegin, old_capacity * sizeof(T), capacity * sizeof(T)));
+		if (fresh) {
+			instrumentation::allocated<T>(capacity * sizeof(T));
+		} else {
+			instrumentation::reallocated<T>((capacity - old_capacity) * sizeof(T));
+		}
+		if (offset != front && n != 0) {
+			std::memmove(new_storage + offset, new_storage + front, n * sizeof(T));
 		}
-		operator delete(sbegin);
+
+		sbegin = new_storage;
+		send = sbegin + capacity;
+		dbegin = sbegin + offset;
+		dend = dbegin + n;
+	}
+
+	void reallocate(uint64_t capacity, uint64_t offset, std::false_type) {
+		if (sbegin != nullptr) { instrumentation::relocated<T>(); }
+		T* new_storage = allocate(capacity);
+		T* new_data = new_storage + offset;
+		T* new_data_end = new_data;
+
+		relocate(new_data, trivial{});
+		new_data_end += size();
+		deallocate(sbegin, send - sbegin);
 
 		sbegin = new_storage;
 		send = sbegin + capacity;
@@ -405,13 +584,29 @@ private:
 		dend = new_data_end;
 	}
 
+	/* moves the elements to new_data (and deconstructs the originals) */
+	void relocate(T* new_data, std::true_type) {
+		if (dbegin != dend) { std::memcpy(new_data, dbegin, size() * sizeof(T)); }
+	}
+
+	void relocate(T* new_data, std::false_type) {
+		T* p = dbegin;
+		while (p != dend) {
+			new (new_data) T(std::move(*p));
+			p->~T();
+			++p;
+			++new_data;
+		}
+	}
+
 	void ensure_front_capacity(uint64_t front_capacity) {
 		if (front_capacity <= (uint64_t) (dbegin - sbegin)) { // sufficient capacity
 			return;
 		}
 
-		/* try doubling capacity */
+		/* try doubling capacity (a moved-from vector has none) */
 		uint64_t capacity = 2 * (send - sbegin);
+		if (capacity == 0) { capacity = minimum_capacity; }
 
 		while (capacity < front_capacity) {
 			capacity *= 2;
@@ -423,23 +618,8 @@ private:
 		uint64_t excess_capacity = capacity - size();
 		if (front_capacity < excess_capacity / 2) { front_capacity = excess_capacity / 2; }
 
-		T* new_storage = reinterpret_cast<T*>(operator new(sizeof(T) * capacity));
-		T* new_data = new_storage + front_capacity;
-		T* new_data_end = new_data;
-
-		/* move the elements (and deconstruct the originals) */
-		while (dbegin != dend) {
-			new (new_data_end) T(std::move(*dbegin));
-			dbegin->~T();
-			++dbegin;
-			++new_data_end;
-		}
-		operator delete(sbegin);
-
-		sbegin = new_storage;
-		send = sbegin + capacity;
-		dbegin = new_data;
-		dend = new_data_end;
+		/* the data has to shift towards the back anyway, so realloc buys nothing */
+		reallocate(capacity, front_capacity, std::false_type{});
 	}
 
 };